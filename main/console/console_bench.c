@@ -0,0 +1,464 @@
+#include "console_bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <esp_console.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <argtable3/argtable3.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <stdatomic.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#else
+#include <esp_cpu.h>
+#include <esp_rom_sys.h>
+#endif
+
+#include "console/console_nvs.h"
+#include "myware/myware_nvs.h"
+#include "myware/myware_ring.h"
+#include "systems/system_term.h"
+
+#define BENCH_TAG "bench"
+
+typedef void (*bench_fn_t)(void *context, int i);
+
+static struct {
+	struct {
+		struct arg_int *count;
+		struct arg_str *filter;
+		struct arg_end *end;
+	} bench;
+	struct {
+		struct arg_int *producers;
+		struct arg_int *readers;
+		struct arg_int *lossy;
+		struct arg_int *count;
+		struct arg_end *end;
+	} ring_test;
+} sargs;
+
+// Shared by the tasks of one ring-test run, left allocated if a task never finishes
+typedef struct {
+	myware_ring_t ring;
+	int producers;
+	int count;
+	SemaphoreHandle_t done;
+	atomic_uint full;
+	atomic_uint errors;
+	atomic_uint skipped;
+} private_ring_test_t;
+
+typedef struct {
+	private_ring_test_t *test;
+	int index;
+	bool lossy;
+} private_ring_task_t;
+
+// Record written by the producers, followed by len bytes of payload
+typedef struct {
+	uint16_t producer;
+	uint16_t len;
+	uint32_t seq;
+	uint8_t payload[];
+} private_ring_record_t;
+
+static struct {
+	system_log_t *log;
+	system_web_t *web;
+	// Only touched by the command, which esp_console runs one at a time
+	RingbufHandle_t rb;
+	myware_ring_t ring;
+	int ring_reader;
+} private_bench;
+
+static const char private_padding[] = "................................................................"
+                                      "................................................................"
+                                      "................................................................"
+                                      "................................................................";
+
+static uint32_t private_cycles(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+	// No cycle counter on the host, nanoseconds stand in for cycles
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#else
+	return esp_cpu_get_cycle_count();
+#endif
+}
+
+static uint32_t private_cycles_per_us(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+	return 1000;
+#else
+	return esp_rom_get_cpu_ticks_per_us();
+#endif
+}
+
+static int private_cmp(const void *a, const void *b)
+{
+	uint32_t va = *(const uint32_t *)a;
+	uint32_t vb = *(const uint32_t *)b;
+	return (va > vb) - (va < vb);
+}
+
+static void private_run(const char *name, bench_fn_t fn, void *context, uint32_t *samples, int count)
+{
+	const char *filter = (sargs.bench.filter->count > 0) ? sargs.bench.filter->sval[0] : NULL;
+	if (filter != NULL && strstr(name, filter) == NULL) {
+		return;
+	}
+	// One untimed call warms the cache and does first time allocations
+	fn(context, -1);
+	for (int i = 0; i < count; i++) {
+		uint32_t start = private_cycles();
+		fn(context, i);
+		samples[i] = private_cycles() - start;
+	}
+	qsort(samples, count, sizeof(uint32_t), private_cmp);
+	uint32_t median = samples[count / 2];
+	uint32_t p99 = samples[MIN(count - 1, (count * 99) / 100)];
+	uint32_t per_us = private_cycles_per_us();
+	fprintf(system_term_out(), "%-24s %10u %10u %10u %8u.%02u\n", name, (unsigned)samples[0], (unsigned)median, (unsigned)p99, (unsigned)(median / per_us), (unsigned)((median % per_us) * 100 / per_us));
+	fflush(system_term_out());
+}
+
+static void private_log(void *context, int i)
+{
+	int len = (int)(intptr_t)context;
+	ESP_LOGI(BENCH_TAG, "%i %.*s", i, len, private_padding);
+}
+
+static void private_ringbuf(void *context, int i)
+{
+	static const uint8_t data[32];
+	size_t len;
+	xRingbufferSend(private_bench.rb, data, sizeof(data), 0);
+	void *item = xRingbufferReceive(private_bench.rb, &len, 0);
+	if (item != NULL) {
+		vRingbufferReturnItem(private_bench.rb, item);
+	}
+}
+
+static void private_ring(void *context, int i)
+{
+	myware_ring_t *ring = &private_bench.ring;
+	void *record = Myware_ring_reserve(ring, 32);
+	if (record == NULL) {
+		return;
+	}
+	memset(record, 0, 32);
+	Myware_ring_commit(ring, record);
+	size_t len;
+	void *item = Myware_ring_receive(ring, private_bench.ring_reader, &len, 0);
+	if (item != NULL) {
+		Myware_ring_release(ring, private_bench.ring_reader, item);
+	}
+}
+
+static void private_broadcast(void *context, int i)
+{
+	char line[64];
+	int len = snprintf(line, sizeof(line), "bench %i\n", i);
+	system_web_broadcast(private_bench.web, line, len);
+}
+
+static void private_nvs_get_bool(void *context, int i)
+{
+	bool value;
+	Myware_nvs_get_bool_verbose("web_start", &value);
+}
+
+static void private_nvs_get_u32(void *context, int i)
+{
+	uint32_t value;
+	Myware_nvs_get_u32_verbose("log_udp_port", &value);
+}
+
+static void private_nvs_get_str(void *context, int i)
+{
+	char value[32];
+	Myware_nvs_get_str_verbose("wifi_ssid", value, sizeof(value));
+}
+
+static void private_nvs_set(void *context, int i)
+{
+	const char *type = context;
+	char key[16];
+	char value[24];
+	snprintf(key, sizeof(key), "bench_%s", type);
+	// Each value differs from the stored one, so every call writes
+	if (strcmp(type, "blob") == 0) {
+		snprintf(value, sizeof(value), "%08x", (unsigned)(i + 1));
+	} else {
+		snprintf(value, sizeof(value), "%i", (i + 1) & 0x7f);
+	}
+	console_nvs_set_value(key, type, value);
+}
+
+static void private_hex_decode(void *context, int i)
+{
+	static const char hex[] = "00112233445566778899aabbccddeeff00112233445566778899AABBCCDDEEFF";
+	char blob[sizeof(hex) / 2];
+	console_nvs_hex_decode(hex, blob);
+}
+
+static int cb_bench(int argc, char **argv)
+{
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.bench);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.bench.end, argv[0]);
+		return 1;
+	}
+	int count = (sargs.bench.count->count > 0) ? sargs.bench.count->ival[0] : 100;
+	if (count < 1 || count > 10000) {
+		fprintf(system_term_out(), "bench runs 1 to 10000 iterations\n");
+		return 1;
+	}
+	uint32_t *samples = malloc(count * sizeof(uint32_t));
+	if (samples == NULL) {
+		ESP_LOGE(__func__, "malloc() failed");
+		return 1;
+	}
+	if (private_bench.rb == NULL) {
+		private_bench.rb = xRingbufferCreate(1024, RINGBUF_TYPE_NOSPLIT);
+	}
+	if (private_bench.ring.buf == NULL && Myware_ring_init(&private_bench.ring, 1024) == ESP_OK) {
+		private_bench.ring_reader = Myware_ring_reader_add(&private_bench.ring);
+	}
+	// Lines must reach the sinks, not be counted as repeats or rate limited. The tag's rate is put back afterwards.
+	uint32_t rate;
+	uint32_t burst;
+	bool rate_custom = system_log_get_rate(private_bench.log, BENCH_TAG, &rate, &burst);
+	system_log_set_rate(private_bench.log, BENCH_TAG, 0, 1);
+
+#if CONFIG_IDF_TARGET_LINUX
+	fprintf(system_term_out(), "%i iterations, units are ns\n", count);
+#else
+	fprintf(system_term_out(), "%i iterations, units are CPU cycles at %u MHz\n", count, (unsigned)private_cycles_per_us());
+#endif
+	fprintf(system_term_out(), "%-24s %10s %10s %10s %11s\n", "operation", "min", "median", "p99", "median us");
+	private_run("log 16", private_log, (void *)16, samples, count);
+	private_run("log 64", private_log, (void *)64, samples, count);
+	private_run("log 256", private_log, (void *)256, samples, count);
+	if (private_bench.rb != NULL) {
+		private_run("ringbuf 32", private_ringbuf, NULL, samples, count);
+	}
+	if (private_bench.ring.buf != NULL && private_bench.ring_reader >= 0) {
+		private_run("ring 32", private_ring, NULL, samples, count);
+	}
+	if (private_bench.web->clients_lock != NULL) {
+		private_run("web broadcast", private_broadcast, NULL, samples, count);
+	}
+	private_run("nvs get bool", private_nvs_get_bool, NULL, samples, count);
+	private_run("nvs get u32", private_nvs_get_u32, NULL, samples, count);
+	private_run("nvs get str", private_nvs_get_str, NULL, samples, count);
+	if (sargs.bench.filter->count > 0) {
+		// Every call writes flash, so these only run when the filter asks for them, e.g. bench "nvs set"
+		private_run("nvs set u8", private_nvs_set, "u8", samples, count);
+		private_run("nvs set u32", private_nvs_set, "u32", samples, count);
+		private_run("nvs set i64", private_nvs_set, "i64", samples, count);
+		private_run("nvs set str", private_nvs_set, "str", samples, count);
+		private_run("nvs set blob", private_nvs_set, "blob", samples, count);
+	}
+	private_run("hex decode 32", private_hex_decode, NULL, samples, count);
+	free(samples);
+	if (rate_custom) {
+		system_log_set_rate(private_bench.log, BENCH_TAG, rate, burst);
+	} else {
+		system_log_reset_rate(private_bench.log, BENCH_TAG);
+	}
+	return 0;
+}
+
+static uint8_t private_ring_byte(uint32_t producer, uint32_t seq, uint32_t i)
+{
+	return (uint8_t)(producer * 31 + seq * 7 + i);
+}
+
+static void private_task_ring_producer(private_ring_task_t *task)
+{
+	private_ring_test_t *test = task->test;
+	for (uint32_t seq = 0; seq < (uint32_t)test->count; seq++) {
+		// Lengths vary so that records straddle the end of the buffer and get padding in front
+		uint16_t len = (seq * 13 + task->index * 5) % 97;
+		private_ring_record_t *record;
+		while ((record = Myware_ring_reserve(&test->ring, sizeof(private_ring_record_t) + len)) == NULL) {
+			atomic_fetch_add(&test->full, 1);
+			vTaskDelay(1);
+		}
+		record->producer = task->index;
+		record->len = len;
+		record->seq = seq;
+		for (uint32_t i = 0; i < len; i++) {
+			record->payload[i] = private_ring_byte(task->index, seq, i);
+		}
+		if ((seq & 7) == 0) {
+			// An uncommitted record must hold back the ones reserved after it
+			taskYIELD();
+		}
+		Myware_ring_commit(&test->ring, record);
+	}
+	xSemaphoreGive(test->done);
+	vTaskDelete(NULL);
+}
+
+static void private_task_ring_reader(private_ring_task_t *task)
+{
+	private_ring_test_t *test = task->test;
+	uint32_t next[16] = {0};
+	uint32_t total = test->producers * test->count;
+	uint32_t skipped = 0;
+	uint32_t got = 0;
+	while ((got + skipped) < total) {
+		size_t len;
+		private_ring_record_t *record = Myware_ring_receive(&test->ring, task->index, &len, pdMS_TO_TICKS(1000));
+		skipped += Myware_ring_reader_skipped(&test->ring, task->index, NULL);
+		if (record == NULL) {
+			continue;
+		}
+		bool ok = record->producer < test->producers && len == sizeof(private_ring_record_t) + record->len;
+		// Every reader sees every producer's records in order and none twice, a lossy one may miss some
+		ok = ok && (task->lossy ? (record->seq >= next[record->producer]) : (record->seq == next[record->producer]));
+		for (uint32_t i = 0; ok && i < record->len; i++) {
+			ok = record->payload[i] == private_ring_byte(record->producer, record->seq, i);
+		}
+		if (ok == false) {
+			atomic_fetch_add(&test->errors, 1);
+		}
+		if (record->producer < test->producers) {
+			next[record->producer] = record->seq + 1;
+		}
+		Myware_ring_release(&test->ring, task->index, record);
+		got++;
+		if (task->lossy && (got & 15) == 0) {
+			// Slower than the producers, so that they skip it
+			vTaskDelay(1);
+		}
+	}
+	if ((got + skipped) != total) {
+		// Every record is either read or counted as skipped
+		atomic_fetch_add(&test->errors, 1);
+	}
+	atomic_fetch_add(&test->skipped, skipped);
+	xSemaphoreGive(test->done);
+	vTaskDelete(NULL);
+}
+
+static int cb_ring_test(int argc, char **argv)
+{
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.ring_test);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.ring_test.end, argv[0]);
+		return 1;
+	}
+	int producers = (sargs.ring_test.producers->count > 0) ? sargs.ring_test.producers->ival[0] : 4;
+	int readers = (sargs.ring_test.readers->count > 0) ? sargs.ring_test.readers->ival[0] : 2;
+	int lossy = (sargs.ring_test.lossy->count > 0) ? sargs.ring_test.lossy->ival[0] : 1;
+	int count = (sargs.ring_test.count->count > 0) ? sargs.ring_test.count->ival[0] : 10000;
+	if (producers < 1 || producers > 16 || readers < 1 || lossy < 0 || (readers + lossy) > MYWARE_RING_READERS_MAX || count < 1) {
+		fprintf(system_term_out(), "ring-test takes 1 to 16 producers and 1 to %d readers, lossy ones included\n", MYWARE_RING_READERS_MAX);
+		return 1;
+	}
+	private_ring_test_t *test = calloc(1, sizeof(private_ring_test_t));
+	readers += lossy;
+	private_ring_task_t *tasks = calloc(producers + readers, sizeof(private_ring_task_t));
+	if (test == NULL || tasks == NULL) {
+		ESP_LOGE(__func__, "calloc() failed");
+		free(test);
+		free(tasks);
+		return 1;
+	}
+	// Small, so that it wraps and runs full many times
+	esp_err_t e = Myware_ring_init(&test->ring, 1024);
+	test->done = xSemaphoreCreateCounting(producers + readers, 0);
+	if (e != ESP_OK || test->done == NULL) {
+		ESP_LOGE(__func__, "ring-test setup failed");
+		free(test->ring.buf);
+		free(test);
+		free(tasks);
+		return 1;
+	}
+	test->producers = producers;
+	test->count = count;
+	// Readers first, a reader only sees records reserved after it was added
+	for (int i = 0; i < readers; i++) {
+		tasks[producers + i].test = test;
+		tasks[producers + i].index = Myware_ring_reader_add(&test->ring);
+		tasks[producers + i].lossy = i >= (readers - lossy);
+		Myware_ring_reader_set_lossy(&test->ring, tasks[producers + i].index, tasks[producers + i].lossy);
+		xTaskCreate((TaskFunction_t)private_task_ring_reader, "ring_rd", 1024 * 3, &tasks[producers + i], 5, NULL);
+	}
+	int64_t start = esp_timer_get_time();
+	for (int i = 0; i < producers; i++) {
+		tasks[i].test = test;
+		tasks[i].index = i;
+		// Two priorities, so that producers also preempt each other between reserve and commit
+		xTaskCreate((TaskFunction_t)private_task_ring_producer, "ring_wr", 1024 * 3, &tasks[i], 3 + (i & 1), NULL);
+	}
+	int finished = 0;
+	while (finished < (producers + readers) && xSemaphoreTake(test->done, pdMS_TO_TICKS(30000)) == pdTRUE) {
+		finished++;
+	}
+	int64_t us = esp_timer_get_time() - start;
+	unsigned errors = atomic_load(&test->errors);
+	fprintf(system_term_out(), "%d producers, %d readers, %d lossy, %d records each: %u errors, ring full %u times, %u dropped, %u skipped, %lld ms\n", producers, readers - lossy, lossy, count, errors, atomic_load(&test->full), atomic_load(&test->ring.dropped), atomic_load(&test->skipped), (long long)(us / 1000));
+	if (finished < (producers + readers)) {
+		// The tasks still use the test, it is left allocated
+		fprintf(system_term_out(), "FAIL: %d of %d tasks did not finish\n", (producers + readers) - finished, producers + readers);
+		return 1;
+	}
+	vSemaphoreDelete(test->done);
+	free(test->ring.buf);
+	free(test);
+	free(tasks);
+	if (errors > 0) {
+		fprintf(system_term_out(), "FAIL\n");
+		return 1;
+	}
+	fprintf(system_term_out(), "PASS\n");
+	return 0;
+}
+
+void console_bench_init(system_log_t *log, system_web_t *web)
+{
+	private_bench.log = log;
+	private_bench.web = web;
+	private_bench.ring_reader = -1;
+	sargs.bench.count = arg_int0("n", "count", "<n>", "iterations per operation, 100 by default");
+	sargs.bench.filter = arg_str0(NULL, NULL, "<filter>", "only run operations whose name contains this, nvs set rows only run when it is given");
+	sargs.bench.end = arg_end(2);
+
+	const esp_console_cmd_t cmd_bench = {
+	.command = "bench",
+	.help = "Time the hot paths and print min, median and p99 per operation",
+	.hint = NULL,
+	.func = &cb_bench,
+	.argtable = &sargs.bench};
+
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_bench));
+
+	sargs.ring_test.producers = arg_int0("p", "producers", "<n>", "producer tasks, 4 by default");
+	sargs.ring_test.readers = arg_int0("r", "readers", "<n>", "reader tasks, 2 by default");
+	sargs.ring_test.lossy = arg_int0("l", "lossy", "<n>", "slow lossy reader tasks, 1 by default");
+	sargs.ring_test.count = arg_int0("n", "count", "<n>", "records per producer, 10000 by default");
+	sargs.ring_test.end = arg_end(4);
+
+	const esp_console_cmd_t cmd_ring_test = {
+	.command = "ring-test",
+	.help = "Stress the lock-free log ring with concurrent producers and readers and check every record",
+	.hint = NULL,
+	.func = &cb_ring_test,
+	.argtable = &sargs.ring_test};
+
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_ring_test));
+}
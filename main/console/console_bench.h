@@ -0,0 +1,6 @@
+#pragma once
+
+#include "systems/system_log.h"
+#include "systems/system_web.h"
+
+void console_bench_init(system_log_t *log, system_web_t *web);
@@ -0,0 +1,236 @@
+#include "console_log.h"
+
+#include <string.h>
+#include <sys/param.h>
+#include <esp_console.h>
+#include <argtable3/argtable3.h>
+#include <esp_log.h>
+
+#include "myware/myware_log.h"
+#include "systems/system_term.h"
+
+static struct {
+	struct {
+		struct arg_str *mode;
+		struct arg_end *end;
+	} log_trace;
+	struct {
+		struct arg_str *name;
+		struct arg_str *settings;
+		struct arg_end *end;
+	} log_sink;
+	struct {
+		struct arg_str *tag;
+		struct arg_int *rate;
+		struct arg_int *burst;
+		struct arg_end *end;
+	} log_rate;
+	struct {
+		struct arg_lit *reset;
+		struct arg_end *end;
+	} log_latency;
+	struct {
+		struct arg_int *count;
+		struct arg_int *size;
+		struct arg_str *text;
+		struct arg_end *end;
+	} log_flood;
+} sargs;
+
+static int cb_log_trace(void *context, int argc, char **argv)
+{
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.log_trace);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.log_trace.end, argv[0]);
+		return 1;
+	}
+	char const *mode = sargs.log_trace.mode->sval[0];
+	if (strcmp(mode, "on") == 0) {
+		Myware_log_set_trace(true);
+	} else if (strcmp(mode, "off") == 0) {
+		Myware_log_set_trace(false);
+	} else {
+		ESP_LOGE(__func__, "Expected on or off, got '%s'", mode);
+		return 1;
+	}
+	fprintf(system_term_out(), "trace mode: %s\n", Myware_log_get_trace() ? "on" : "off");
+	return 0;
+}
+
+static int cb_log_sinks(void *context, int argc, char **argv)
+{
+	system_log_print_sinks(context, system_term_out());
+	return 0;
+}
+
+static int cb_log_latency(void *context, int argc, char **argv)
+{
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.log_latency);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.log_latency.end, argv[0]);
+		return 1;
+	}
+	system_log_print_latency(context, system_term_out());
+	if (sargs.log_latency.reset->count > 0) {
+		system_log_reset_latency(context);
+	}
+	return 0;
+}
+
+static int cb_log_flood(void *context, int argc, char **argv)
+{
+	static const char padding[] = "................................................................"
+	                              "................................................................";
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.log_flood);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.log_flood.end, argv[0]);
+		return 1;
+	}
+	int count = (sargs.log_flood.count->count > 0) ? sargs.log_flood.count->ival[0] : 100;
+	int size = (sargs.log_flood.size->count > 0) ? sargs.log_flood.size->ival[0] : 0;
+	const char *text = (sargs.log_flood.text->count > 0) ? sargs.log_flood.text->sval[0] : "flood";
+	if (count < 1 || count > 100000 || size < 0 || size > (int)sizeof(padding) - 1) {
+		fprintf(system_term_out(), "log-flood takes 1 to 100000 lines and 0 to %u bytes of padding\n", (unsigned)sizeof(padding) - 1);
+		return 1;
+	}
+	// Every line differs in its sequence number, so none is collapsed as a repeat. Rate limits still apply, see log-rate flood.
+	for (int i = 0; i < count; i++) {
+		ESP_LOGI("flood", "%s %i %.*s", text, i, size, padding);
+	}
+	fprintf(system_term_out(), "%i lines logged\n", count);
+	return 0;
+}
+
+static int cb_log_sink(void *context, int argc, char **argv)
+{
+	system_log_t *log = context;
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.log_sink);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.log_sink.end, argv[0]);
+		return 1;
+	}
+	char const *name = sargs.log_sink.name->sval[0];
+	system_log_sink_t *sink = system_log_sink_find(log, name);
+	if (sink == NULL) {
+		fprintf(system_term_out(), "No sink named '%s', see log-sinks\n", name);
+		return 1;
+	}
+	for (int i = 0; i < sargs.log_sink.settings->count; i++) {
+		char const *str = sargs.log_sink.settings->sval[i];
+		uint8_t level;
+		if (Myware_log_level_parse(str, &level)) {
+			sink->level = level;
+		} else if (strcmp(str, "drop") == 0) {
+			system_log_sink_set_block(log, sink, false);
+		} else if (strcmp(str, "block") == 0) {
+			system_log_sink_set_block(log, sink, true);
+		} else {
+			ESP_LOGE(__func__, "Expected a level, drop or block, got '%s'", str);
+			return 1;
+		}
+	}
+	system_log_print_sinks(log, system_term_out());
+	return 0;
+}
+
+static int cb_log_rate(void *context, int argc, char **argv)
+{
+	system_log_t *log = context;
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.log_rate);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.log_rate.end, argv[0]);
+		return 1;
+	}
+	if (sargs.log_rate.tag->count > 0) {
+		if (sargs.log_rate.rate->count == 0 || sargs.log_rate.rate->ival[0] < 0) {
+			fprintf(system_term_out(), "log-rate needs a rate of 0 or more lines per second after the tag\n");
+			return 1;
+		}
+		uint32_t rate = sargs.log_rate.rate->ival[0];
+		// Default burst is rate * 2.5, matching the Kconfig defaults
+		uint32_t burst = (sargs.log_rate.burst->count > 0) ? sargs.log_rate.burst->ival[0] : (rate * 5 + 1) / 2;
+		esp_err_t e = system_log_set_rate(log, sargs.log_rate.tag->sval[0], rate, MAX(burst, 1));
+		if (e != ESP_OK) {
+			fprintf(system_term_out(), "log-rate failed: %s\n", esp_err_to_name(e));
+			return 1;
+		}
+	}
+	system_log_print_rates(log, system_term_out());
+	return 0;
+}
+
+void console_log_init(system_log_t *log)
+{
+	sargs.log_trace.mode = arg_str1(NULL, NULL, "<on|off>", "on or off");
+	sargs.log_trace.end = arg_end(1);
+	sargs.log_sink.name = arg_str1(NULL, NULL, "<sink>", "uart, web, file or udp");
+	sargs.log_sink.settings = arg_strn(NULL, NULL, "<level|drop|block>", 0, 2, "highest level the sink takes, what logging does when the sink is behind");
+	sargs.log_sink.end = arg_end(3);
+	sargs.log_rate.tag = arg_str0(NULL, NULL, "<tag>", "log tag, * for every tag without its own rate (info and below)");
+	sargs.log_rate.rate = arg_int0(NULL, NULL, "<rate>", "lines per second, 0 is unlimited");
+	sargs.log_rate.burst = arg_int0(NULL, NULL, "<burst>", "lines the tag can log at once");
+	sargs.log_rate.end = arg_end(3);
+	sargs.log_latency.reset = arg_lit0("r", "reset", "start new histograms after printing");
+	sargs.log_latency.end = arg_end(1);
+	sargs.log_flood.count = arg_int0("n", "count", "<n>", "lines to log, 100 by default");
+	sargs.log_flood.size = arg_int0("s", "size", "<bytes>", "padding added to each line");
+	sargs.log_flood.text = arg_str0(NULL, NULL, "<text>", "start of every line, flood by default");
+	sargs.log_flood.end = arg_end(3);
+
+	const esp_console_cmd_t cmd_log_trace = {
+	.command = "log-trace",
+	.help = "Send ESP_LOGx lines unformatted to binary WebSocket clients, see tools/ws_log.py",
+	.hint = NULL,
+	.func_w_context = &cb_log_trace,
+	.context = NULL,
+	.argtable = &sargs.log_trace};
+
+	const esp_console_cmd_t cmd_log_sinks = {
+	.command = "log-sinks",
+	.help = "Show the log sinks and their counters",
+	.hint = NULL,
+	.func_w_context = &cb_log_sinks,
+	.context = log,
+	};
+
+	const esp_console_cmd_t cmd_log_sink = {
+	.command = "log-sink",
+	.help = "Set the level and full ring policy of a log sink",
+	.hint = NULL,
+	.func_w_context = &cb_log_sink,
+	.context = log,
+	.argtable = &sargs.log_sink};
+
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_log_trace));
+	const esp_console_cmd_t cmd_log_rate = {
+	.command = "log-rate",
+	.help = "Show repeat and rate limit counters per tag, or set a tag's rate limit",
+	.hint = NULL,
+	.func_w_context = &cb_log_rate,
+	.context = log,
+	.argtable = &sargs.log_rate};
+
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_log_sinks));
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_log_rate));
+
+	const esp_console_cmd_t cmd_log_latency = {
+	.command = "log-latency",
+	.help = "Show p50, p99 and max time from logging a line to each sink writing it out",
+	.hint = NULL,
+	.func_w_context = &cb_log_latency,
+	.context = log,
+	.argtable = &sargs.log_latency};
+
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_log_latency));
+
+	const esp_console_cmd_t cmd_log_flood = {
+	.command = "log-flood",
+	.help = "Log numbered lines with the tag flood, for load tests of the log path",
+	.hint = NULL,
+	.func_w_context = &cb_log_flood,
+	.context = log,
+	.argtable = &sargs.log_flood};
+
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_log_flood));
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_log_sink));
+}
@@ -0,0 +1,4 @@
+#pragma once
+#include "systems/system_log.h"
+
+void console_log_init(system_log_t *log);
@@ -12,6 +12,8 @@
 #include <esp_err.h>
 #include <nvs.h>
 
+#include "systems/system_term.h"
+
 typedef struct {
 	nvs_type_t type;
 	const char *str;
@@ -95,22 +97,13 @@ static const char *type_to_str(nvs_type_t type)
 	return "Unknown";
 }
 
-static esp_err_t store_blob(nvs_handle_t nvs, const char *key, const char *str_values)
+esp_err_t console_nvs_hex_decode(const char *str_values, char *blob)
 {
 	uint8_t value;
 	size_t str_len = strlen(str_values);
-	size_t blob_len = str_len / 2;
-
 	if (str_len % 2) {
-		ESP_LOGE(TAG, "Blob data must contain even number of characters");
 		return ESP_ERR_NVS_TYPE_MISMATCH;
 	}
-
-	char *blob = (char *)malloc(blob_len);
-	if (blob == NULL) {
-		return ESP_ERR_NO_MEM;
-	}
-
 	for (int i = 0, j = 0; i < str_len; i++) {
 		char ch = str_values[i];
 		if (ch >= '0' && ch <= '9') {
@@ -121,7 +114,6 @@ static esp_err_t store_blob(nvs_handle_t nvs, const char *key, const char *str_v
 			value = ch - 'a' + 10;
 		} else {
 			ESP_LOGE(TAG, "Blob data contain invalid character");
-			free(blob);
 			return ESP_ERR_NVS_TYPE_MISMATCH;
 		}
 
@@ -131,8 +123,31 @@ static esp_err_t store_blob(nvs_handle_t nvs, const char *key, const char *str_v
 			blob[j] = value << 4;
 		}
 	}
+	return ESP_OK;
+}
+
+static esp_err_t store_blob(nvs_handle_t nvs, const char *key, const char *str_values)
+{
+	size_t str_len = strlen(str_values);
+	size_t blob_len = str_len / 2;
 
-	esp_err_t err = nvs_set_blob(nvs, key, blob, blob_len);
+	if (str_len % 2) {
+		ESP_LOGE(TAG, "Blob data must contain even number of characters");
+		return ESP_ERR_NVS_TYPE_MISMATCH;
+	}
+
+	char *blob = (char *)malloc(blob_len);
+	if (blob == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	esp_err_t err = console_nvs_hex_decode(str_values, blob);
+	if (err != ESP_OK) {
+		free(blob);
+		return err;
+	}
+
+	err = nvs_set_blob(nvs, key, blob, blob_len);
 	free(blob);
 
 	if (err == ESP_OK) {
@@ -254,6 +269,11 @@ static esp_err_t set_value_in_nvs(const char *key, const char *str_type, const c
 	return err;
 }
 
+esp_err_t console_nvs_set_value(const char *key, const char *str_type, const char *str_value)
+{
+	return set_value_in_nvs(key, str_type, str_value);
+}
+
 static esp_err_t get_value_from_nvs(nvs_handle_t nvs, const char *key, nvs_type_t type, char out_buf[], int out_buf_size)
 {
 	esp_err_t e = ESP_FAIL;
@@ -319,7 +339,7 @@ static esp_err_t get_value_from_nvs(nvs_handle_t nvs, const char *key, nvs_type_
 		if (e != ESP_OK) {
 			break;
 		}
-		snprintf(out_buf, out_buf_size, "%lld", value);
+		snprintf(out_buf, out_buf_size, "%" PRId64, value);
 	} break;
 
 	case NVS_TYPE_U64: {
@@ -328,7 +348,7 @@ static esp_err_t get_value_from_nvs(nvs_handle_t nvs, const char *key, nvs_type_
 		if (e != ESP_OK) {
 			break;
 		}
-		snprintf(out_buf, out_buf_size, "%llu", value);
+		snprintf(out_buf, out_buf_size, "%" PRIu64, value);
 	} break;
 
 	case NVS_TYPE_STR: {
@@ -414,7 +434,7 @@ static int list(const char *part, const char *name, const char *str_type)
 		return 1;
 	}
 
-	printf(FORMAT_NVS_LIST, "namespace", "key", "type", "value");
+	fprintf(system_term_out(), FORMAT_NVS_LIST, "namespace", "key", "type", "value");
 
 	while (1) {
 		nvs_entry_info_t info;
@@ -438,7 +458,7 @@ static int list(const char *part, const char *name, const char *str_type)
 		}
 
 		nvs_close(nvs);
-		printf(FORMAT_NVS_LIST, info.namespace_name, info.key, type_to_str(info.type), buf);
+		fprintf(system_term_out(), FORMAT_NVS_LIST, info.namespace_name, info.key, type_to_str(info.type), buf);
 
 		e = nvs_entry_next(&it);
 		if (e != ESP_OK) {
@@ -453,7 +473,7 @@ static int set_value(int argc, char **argv)
 {
 	int nerrors = arg_parse(argc, argv, (void **)&set_args);
 	if (nerrors != 0) {
-		arg_print_errors(stderr, set_args.end, argv[0]);
+		arg_print_errors(system_term_out(), set_args.end, argv[0]);
 		return 1;
 	}
 
@@ -476,7 +496,7 @@ static int get_value(int argc, char **argv)
 	esp_err_t e;
 	int nerrors = arg_parse(argc, argv, (void **)&get_args);
 	if (nerrors != 0) {
-		arg_print_errors(stderr, get_args.end, argv[0]);
+		arg_print_errors(system_term_out(), get_args.end, argv[0]);
 		return 1;
 	}
 
@@ -502,7 +522,7 @@ static int get_value(int argc, char **argv)
 		ESP_LOGE(__func__, "%s", esp_err_to_name(e));
 		return 1;
 	}
-	printf("%s\n", buf);
+	fprintf(system_term_out(), "%s\n", buf);
 	nvs_close(handle);
 	return 0;
 }
@@ -511,7 +531,7 @@ static int erase_value(int argc, char **argv)
 {
 	int nerrors = arg_parse(argc, argv, (void **)&erase_args);
 	if (nerrors != 0) {
-		arg_print_errors(stderr, erase_args.end, argv[0]);
+		arg_print_errors(system_term_out(), erase_args.end, argv[0]);
 		return 1;
 	}
 
@@ -531,7 +551,7 @@ static int erase_namespace(int argc, char **argv)
 {
 	int nerrors = arg_parse(argc, argv, (void **)&erase_all_args);
 	if (nerrors != 0) {
-		arg_print_errors(stderr, erase_all_args.end, argv[0]);
+		arg_print_errors(system_term_out(), erase_all_args.end, argv[0]);
 		return 1;
 	}
 
@@ -550,7 +570,7 @@ static int set_namespace(int argc, char **argv)
 {
 	int nerrors = arg_parse(argc, argv, (void **)&namespace_args);
 	if (nerrors != 0) {
-		arg_print_errors(stderr, namespace_args.end, argv[0]);
+		arg_print_errors(system_term_out(), namespace_args.end, argv[0]);
 		return 1;
 	}
 
@@ -568,7 +588,7 @@ static int list_entries(int argc, char **argv)
 
 	int nerrors = arg_parse(argc, argv, (void **)&list_args);
 	if (nerrors != 0) {
-		arg_print_errors(stderr, list_args.end, argv[0]);
+		arg_print_errors(system_term_out(), list_args.end, argv[0]);
 		return 1;
 	}
 
@@ -1,3 +1,11 @@
 #pragma once
 
+#include <esp_err.h>
+
 void console_nvs_init(void);
+
+// What nvs_set does: parses str_value as str_type and stores it under key in the current namespace
+esp_err_t console_nvs_set_value(const char *key, const char *str_type, const char *str_value);
+
+// Decodes an even number of hex digits into strlen(str_values) / 2 bytes of blob
+esp_err_t console_nvs_hex_decode(const char *str_values, char *blob);
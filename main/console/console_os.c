@@ -1,7 +1,32 @@
 #include "console_os.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 #include <esp_console.h>
 #include <esp_log.h>
+#include <argtable3/argtable3.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "myware/myware_heapstat.h"
+#include "systems/system_term.h"
+
+// top holds the console while it samples, so a run is kept to a few minutes
+#define TOP_DURATION_MAX_MS (5 * 60 * 1000)
+
+static struct {
+	struct {
+		struct arg_int *interval;
+		struct arg_int *count;
+		struct arg_end *end;
+	} top;
+	struct {
+		struct arg_int *window;
+		struct arg_str *trace;
+		struct arg_end *end;
+	} heapstat;
+} sargs;
 
 static int cb_tasks(int argc, char **argv)
 {
@@ -11,13 +36,13 @@ static int cb_tasks(int argc, char **argv)
 		ESP_LOGE(__func__, "failed to allocate buffer for vTaskList output");
 		return 1;
 	}
-	fputs("Task Name\tStatus\tPrio\tHWM\tTask#", stdout);
+	fputs("Task Name\tStatus\tPrio\tHWM\tTask#", system_term_out());
 #ifdef CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
-	fputs("\tAffinity", stdout);
+	fputs("\tAffinity", system_term_out());
 #endif
-	fputs("\n", stdout);
+	fputs("\n", system_term_out());
 	vTaskList(task_list_buffer);
-	fputs(task_list_buffer, stdout);
+	fputs(task_list_buffer, system_term_out());
 	free(task_list_buffer);
 	return 0;
 }
@@ -30,14 +55,193 @@ static int cb_restart(int argc, char **argv)
 
 static int cb_heap(int argc, char **argv)
 {
+#if CONFIG_IDF_TARGET_LINUX
+	fprintf(system_term_out(), "heap sizes are not available on the linux target\n");
+#else
 	uint32_t heap_size = heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
-	printf("available heap: %" PRIu32 "B\n", esp_get_free_heap_size());
-	printf("min heap size: %" PRIu32 "B\n", heap_size);
+	fprintf(system_term_out(), "available heap: %" PRIu32 "B\n", esp_get_free_heap_size());
+	fprintf(system_term_out(), "min heap size: %" PRIu32 "B\n", heap_size);
+#endif
+	return 0;
+}
+
+static int cb_heapstat(int argc, char **argv)
+{
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.heapstat);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.heapstat.end, argv[0]);
+		return 1;
+	}
+	if (sargs.heapstat.trace->count > 0) {
+		const char *action = sargs.heapstat.trace->sval[0];
+		esp_err_t e;
+		if (strcmp(action, "start") == 0) {
+			e = Myware_heapstat_trace_start();
+		} else if (strcmp(action, "stop") == 0) {
+			e = Myware_heapstat_trace_stop();
+		} else if (strcmp(action, "dump") == 0) {
+			// heap_trace_dump() prints on the UART only
+			e = Myware_heapstat_trace_dump();
+		} else {
+			fprintf(system_term_out(), "-t takes start, stop or dump\n");
+			return 1;
+		}
+		if (e != ESP_OK) {
+			fprintf(system_term_out(), "heap trace %s failed: %s\n", action, esp_err_to_name(e));
+			return 1;
+		}
+		return 0;
+	}
+
+	Myware_heapstat_print(system_term_out());
+	int window = (sargs.heapstat.window->count > 0) ? sargs.heapstat.window->ival[0] : 1000;
+	if (window < 0 || window > 60000) {
+		fprintf(system_term_out(), "the window is 0 to 60000 ms\n");
+		return 1;
+	}
+	myware_heapstat_counts_t before;
+	if (window == 0 || Myware_heapstat_counts(&before) != ESP_OK) {
+		return 0;
+	}
+	fflush(system_term_out());
+	vTaskDelay(pdMS_TO_TICKS(window));
+	myware_heapstat_counts_t after;
+	Myware_heapstat_counts(&after);
+	uint32_t allocs = after.allocs - before.allocs;
+	uint32_t frees = after.frees - before.frees;
+	uint64_t bytes = after.bytes_allocated - before.bytes_allocated;
+	fprintf(system_term_out(), "over %i ms: %" PRIu32 " allocs/s, %" PRIu32 " frees/s, %" PRIu64 " bytes allocated/s, %+" PRIi32 " live blocks\n", window, (uint32_t)((uint64_t)allocs * 1000 / window), (uint32_t)((uint64_t)frees * 1000 / window), bytes * 1000 / window, (int32_t)(allocs - frees));
+	return 0;
+}
+
+// Run time of one task over the sampled interval
+typedef struct {
+	TaskStatus_t *task;
+	configRUN_TIME_COUNTER_TYPE delta;
+} top_row_t;
+
+static int private_top_row_cmp(const void *a, const void *b)
+{
+	const top_row_t *ra = a;
+	const top_row_t *rb = b;
+	if (ra->delta != rb->delta) {
+		return (ra->delta < rb->delta) ? 1 : -1;
+	}
+	return strcmp(ra->task->pcTaskName, rb->task->pcTaskName);
+}
+
+static char private_task_state(eTaskState state)
+{
+	switch (state) {
+	case eRunning:
+		return 'X';
+	case eReady:
+		return 'R';
+	case eBlocked:
+		return 'B';
+	case eSuspended:
+		return 'S';
+	case eDeleted:
+		return 'D';
+	default:
+		return '?';
+	}
+}
+
+static void private_top_print(TaskStatus_t *prev, UBaseType_t prev_len, TaskStatus_t *curr, UBaseType_t curr_len, top_row_t *rows, configRUN_TIME_COUNTER_TYPE total)
+{
+	// Tasks created during the interval count from zero
+	for (UBaseType_t i = 0; i < curr_len; i++) {
+		configRUN_TIME_COUNTER_TYPE before = 0;
+		for (UBaseType_t j = 0; j < prev_len; j++) {
+			if (prev[j].xTaskNumber == curr[i].xTaskNumber) {
+				before = prev[j].ulRunTimeCounter;
+				break;
+			}
+		}
+		rows[i].task = &curr[i];
+		rows[i].delta = curr[i].ulRunTimeCounter - before;
+	}
+	qsort(rows, curr_len, sizeof(top_row_t), private_top_row_cmp);
+	// Every core adds total to the run time of its tasks
+	uint64_t capacity = (uint64_t)total * configNUMBER_OF_CORES;
+	if (capacity == 0) {
+		capacity = 1;
+	}
+	fprintf(system_term_out(), "%-16s %4s %5s %7s %12s %6s\n", "task", "prio", "state", "cpu", "run time", "hwm");
+	for (UBaseType_t i = 0; i < curr_len; i++) {
+		TaskStatus_t *task = rows[i].task;
+		// Tenths of a percent
+		unsigned permille = (unsigned)(((uint64_t)rows[i].delta * 1000 + capacity / 2) / capacity);
+		fprintf(system_term_out(), "%-16s %4u %5c %5u.%u%% %12" PRIu64 " %6u\n", task->pcTaskName, (unsigned)task->uxCurrentPriority, private_task_state(task->eCurrentState), permille / 10, permille % 10, (uint64_t)rows[i].delta, (unsigned)task->usStackHighWaterMark);
+	}
+}
+
+static int cb_top(int argc, char **argv)
+{
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.top);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.top.end, argv[0]);
+		return 1;
+	}
+	int interval = (sargs.top.interval->count > 0) ? sargs.top.interval->ival[0] : 1000;
+	int count = (sargs.top.count->count > 0) ? sargs.top.count->ival[0] : 1;
+	if (interval < 100 || interval > 60000 || count < 1 || count > 1000) {
+		fprintf(system_term_out(), "top needs an interval of 100 to 60000 ms and a count of 1 to 1000\n");
+		return 1;
+	}
+	if ((int64_t)interval * count > TOP_DURATION_MAX_MS) {
+		fprintf(system_term_out(), "top runs at most %i s, lower the interval or the count\n", TOP_DURATION_MAX_MS / 1000);
+		return 1;
+	}
+
+	// Room for tasks created while sampling
+	UBaseType_t cap = uxTaskGetNumberOfTasks() + 4;
+	TaskStatus_t *prev = malloc(cap * sizeof(TaskStatus_t));
+	TaskStatus_t *curr = malloc(cap * sizeof(TaskStatus_t));
+	top_row_t *rows = malloc(cap * sizeof(top_row_t));
+	if (prev == NULL || curr == NULL || rows == NULL) {
+		ESP_LOGE(__func__, "malloc() failed");
+		free(prev);
+		free(curr);
+		free(rows);
+		return 1;
+	}
+
+	configRUN_TIME_COUNTER_TYPE prev_total;
+	UBaseType_t prev_len = uxTaskGetSystemState(prev, cap, &prev_total);
+	for (int i = 0; i < count; i++) {
+		vTaskDelay(pdMS_TO_TICKS(interval));
+		configRUN_TIME_COUNTER_TYPE curr_total;
+		UBaseType_t curr_len = uxTaskGetSystemState(curr, cap, &curr_total);
+		if (curr_len == 0) {
+			fprintf(system_term_out(), "more than %u tasks, run top again\n", (unsigned)cap);
+			break;
+		}
+		fprintf(system_term_out(), "top %i/%i: %u tasks over %i ms\n", i + 1, count, (unsigned)curr_len, interval);
+		private_top_print(prev, prev_len, curr, curr_len, rows, curr_total - prev_total);
+		// Each sample reaches the UART or the WebSocket session before the next interval
+		fflush(system_term_out());
+		TaskStatus_t *swap = prev;
+		prev = curr;
+		curr = swap;
+		prev_len = curr_len;
+		prev_total = curr_total;
+	}
+	free(prev);
+	free(curr);
+	free(rows);
 	return 0;
 }
 
 void console_os_init()
 {
+	sargs.top.interval = arg_int0("i", "interval", "<ms>", "sample interval, 1000 ms by default");
+	sargs.top.count = arg_int0("n", "count", "<n>", "samples to print, 1 by default");
+	sargs.top.end = arg_end(2);
+	sargs.heapstat.window = arg_int0("w", "window", "<ms>", "window of the alloc and free rates, 1000 ms by default, 0 skips them");
+	sargs.heapstat.trace = arg_str0("t", "trace", "<start|stop|dump>", "record the callers of live allocations, needs CONFIG_HEAP_TRACING_STANDALONE");
+	sargs.heapstat.end = arg_end(2);
 
 	const esp_console_cmd_t cmd_tasks = {
 	.command = "tasks",
@@ -64,5 +268,23 @@ void console_os_init()
 	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_tasks));
 	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_restart));
 
+	const esp_console_cmd_t cmd_top = {
+	.command = "top",
+	.help = "Show the CPU use and stack high-water mark of each task over an interval",
+	.hint = NULL,
+	.func = &cb_top,
+	.argtable = &sargs.top};
+
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_top));
+
+	const esp_console_cmd_t cmd_heapstat = {
+	.command = "heapstat",
+	.help = "Show free memory and fragmentation per capability and the alloc and free rates",
+	.hint = NULL,
+	.func = &cb_heapstat,
+	.argtable = &sargs.heapstat};
+
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_heapstat));
+
 	return;
 }
\ No newline at end of file
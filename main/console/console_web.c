@@ -1,21 +1,219 @@
 #include "console_web.h"
 
+#include <string.h>
 #include <esp_console.h>
+#include <argtable3/argtable3.h>
 #include <esp_log.h>
 
+#include "myware/myware_log.h"
+#include "systems/system_term.h"
+
+typedef struct {
+	system_web_policy_t policy;
+	const char *str;
+} policy_str_pair_t;
+
+static const policy_str_pair_t policy_str_pair[] = {
+{SYSTEM_WEB_POLICY_DROP_OLDEST, "drop-oldest"},
+{SYSTEM_WEB_POLICY_DROP_NEWEST, "drop-newest"},
+{SYSTEM_WEB_POLICY_DISCONNECT, "disconnect"},
+};
+
+static const size_t POLICY_STR_PAIR_SIZE = sizeof(policy_str_pair) / sizeof(policy_str_pair[0]);
+
+static struct {
+	struct {
+		struct arg_str *policy;
+		struct arg_end *end;
+	} web_policy;
+	struct {
+		struct arg_str *format;
+		struct arg_end *end;
+	} web_format;
+	struct {
+		struct arg_str *tag;
+		struct arg_str *level;
+		struct arg_end *end;
+	} web_sub;
+	struct {
+		struct arg_lit *reset;
+		struct arg_end *end;
+	} web_latency;
+} sargs;
+
 static int cb_start(int argc, char **argv)
 {
 	ESP_LOGI(__func__, "Starting web server... NOT IMPLEMENTED");
 	return 0;
 }
 
-void console_web_init(void)
+static int cb_web_clients(void *context, int argc, char **argv)
+{
+	system_web_print_clients(context, system_term_out());
+	return 0;
+}
+
+static int cb_web_policy(void *context, int argc, char **argv)
+{
+	system_web_t *web = context;
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.web_policy);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.web_policy.end, argv[0]);
+		return 1;
+	}
+	char const *str = sargs.web_policy.policy->sval[0];
+	for (int i = 0; i < POLICY_STR_PAIR_SIZE; i++) {
+		if (strcmp(str, policy_str_pair[i].str) == 0) {
+			web->policy = policy_str_pair[i].policy;
+			ESP_LOGI(__func__, "WebSocket queue policy set to %s", str);
+			return 0;
+		}
+	}
+	ESP_LOGE(__func__, "Unknown policy '%s'", str);
+	return 1;
+}
+
+static int cb_web_format(void *context, int argc, char **argv)
+{
+	system_web_t *web = context;
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.web_format);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.web_format.end, argv[0]);
+		return 1;
+	}
+	char const *str = sargs.web_format.format->sval[0];
+	bool binary;
+	if (strcmp(str, "text") == 0) {
+		binary = false;
+	} else if (strcmp(str, "binary") == 0) {
+		binary = true;
+	} else {
+		ESP_LOGE(__func__, "Unknown format '%s'", str);
+		return 1;
+	}
+	esp_err_t e = system_web_set_binary(web, binary);
+	if (e != ESP_OK) {
+		fprintf(system_term_out(), "web-format only works from a WebSocket session\n");
+		return 1;
+	}
+	fprintf(system_term_out(), "log frames: %s\n", str);
+	return 0;
+}
+
+static int cb_web_sub(void *context, int argc, char **argv)
+{
+	system_web_t *web = context;
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.web_sub);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.web_sub.end, argv[0]);
+		return 1;
+	}
+	if (sargs.web_sub.tag->count == 0) {
+		system_web_print_subs(web, system_term_out());
+		return 0;
+	}
+	if (sargs.web_sub.level->count == 0) {
+		fprintf(system_term_out(), "web-sub needs a level after the tag\n");
+		return 1;
+	}
+	char const *tag = sargs.web_sub.tag->sval[0];
+	char const *str = sargs.web_sub.level->sval[0];
+	uint8_t level;
+	if (Myware_log_level_parse(str, &level) == false) {
+		ESP_LOGE(__func__, "Unknown level '%s'", str);
+		return 1;
+	}
+	esp_err_t e = system_web_subscribe(web, tag, level);
+	if (e == ESP_ERR_INVALID_STATE) {
+		fprintf(system_term_out(), "web-sub only works from a WebSocket session\n");
+		return 1;
+	}
+	if (e != ESP_OK) {
+		fprintf(system_term_out(), "web-sub %s failed: %s\n", tag, esp_err_to_name(e));
+		return 1;
+	}
+	fprintf(system_term_out(), "%s: %s\n", tag, str);
+	return 0;
+}
+
+static int cb_web_latency(void *context, int argc, char **argv)
+{
+	int nerrors = arg_parse(argc, argv, (void **)&sargs.web_latency);
+	if (nerrors != 0) {
+		arg_print_errors(system_term_out(), sargs.web_latency.end, argv[0]);
+		return 1;
+	}
+	system_web_print_latency(context, system_term_out());
+	if (sargs.web_latency.reset->count > 0) {
+		system_web_reset_latency(context);
+	}
+	return 0;
+}
+
+void console_web_init(system_web_t *web)
 {
+	sargs.web_policy.policy = arg_str1(NULL, NULL, "<policy>", "drop-oldest, drop-newest or disconnect");
+	sargs.web_policy.end = arg_end(1);
+	sargs.web_format.format = arg_str1(NULL, NULL, "<format>", "text or binary");
+	sargs.web_format.end = arg_end(1);
+	sargs.web_sub.tag = arg_str0(NULL, NULL, "<tag>", "log tag, * for every tag without its own level");
+	sargs.web_sub.level = arg_str0(NULL, NULL, "<level>", "none, error, warn, info, debug or verbose");
+	sargs.web_sub.end = arg_end(2);
+	sargs.web_latency.reset = arg_lit0("r", "reset", "start new histograms after printing");
+	sargs.web_latency.end = arg_end(1);
+
 	const esp_console_cmd_t cmd_start = {
 	.command = "web-start",
 	.help = "Start the web server",
 	.hint = NULL,
 	.func = &cb_start,
 	};
+
+	const esp_console_cmd_t cmd_web_clients = {
+	.command = "web-clients",
+	.help = "Show WebSocket clients and their send queue counters",
+	.hint = NULL,
+	.func_w_context = &cb_web_clients,
+	.context = web,
+	};
+
+	const esp_console_cmd_t cmd_web_policy = {
+	.command = "web-policy",
+	.help = "Set what happens when a WebSocket client's send queue is full",
+	.hint = NULL,
+	.func_w_context = &cb_web_policy,
+	.context = web,
+	.argtable = &sargs.web_policy};
+
+	const esp_console_cmd_t cmd_web_format = {
+	.command = "web-format",
+	.help = "Select text or binary log frames for this WebSocket session",
+	.hint = NULL,
+	.func_w_context = &cb_web_format,
+	.context = web,
+	.argtable = &sargs.web_format};
+
+	const esp_console_cmd_t cmd_web_sub = {
+	.command = "web-sub",
+	.help = "Show or set the log levels this WebSocket session receives per tag",
+	.hint = NULL,
+	.func_w_context = &cb_web_sub,
+	.context = web,
+	.argtable = &sargs.web_sub};
+
 	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_start));
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_web_clients));
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_web_policy));
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_web_format));
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_web_sub));
+
+	const esp_console_cmd_t cmd_web_latency = {
+	.command = "web-latency",
+	.help = "Show p50, p99 and max time from logging a line to its frame being sent, per WebSocket client",
+	.hint = NULL,
+	.func_w_context = &cb_web_latency,
+	.context = web,
+	.argtable = &sargs.web_latency};
+
+	ESP_ERROR_CHECK(esp_console_cmd_register(&cmd_web_latency));
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
 #pragma once
 
-void console_web_init(void);
\ No newline at end of file
+#include "systems/system_web.h"
+
+void console_web_init(system_web_t *web);
\ No newline at end of file
@@ -7,6 +7,7 @@
 
 #include "hardware/hardware_wifi.h"
 #include "myware/myware_nvs.h"
+#include "systems/system_term.h"
 
 static struct {
 	struct {
@@ -20,7 +21,7 @@ static int cb_wifi_cred(void *context, int argc, char **argv)
 {
 	int nerrors = arg_parse(argc, argv, (void **)&sargs.wifi_cred);
 	if (nerrors != 0) {
-		arg_print_errors(stderr, sargs.wifi_cred.end, argv[0]);
+		arg_print_errors(system_term_out(), sargs.wifi_cred.end, argv[0]);
 		return 1;
 	}
 	char const *ssid = sargs.wifi_cred.ssid->sval[0];
@@ -33,7 +34,7 @@ static int cb_wifi_cred(void *context, int argc, char **argv)
 
 static int cb_wifi_scan(void *context, int argc, char **argv)
 {
-	esp_err_t e = Hardware_wifi_scanap();
+	esp_err_t e = Hardware_wifi_scanap(system_term_out());
 	if (e != ESP_OK) {
 		ESP_LOGW(__func__, "Hardware_wifi_scanap() failed, reason = %s", esp_err_to_name(e));
 		return 1;
@@ -43,7 +44,7 @@ static int cb_wifi_scan(void *context, int argc, char **argv)
 
 static int cb_wifi_ip(void *context, int argc, char **argv)
 {
-	Hardware_wifi_print_ip(stdout);
+	Hardware_wifi_print_ip(system_term_out());
 	return 0;
 }
 
@@ -83,7 +84,7 @@ static int cb_wifi_connect(void *context, int argc, char **argv)
 {
 	int nerrors = arg_parse(argc, argv, (void **)&sargs.wifi_cred);
 	if (nerrors != 0) {
-		arg_print_errors(stderr, sargs.wifi_cred.end, argv[0]);
+		arg_print_errors(system_term_out(), sargs.wifi_cred.end, argv[0]);
 		return 1;
 	}
 	char const *ssid = sargs.wifi_cred.ssid->sval[0];
@@ -233,12 +233,26 @@ esp_err_t Hardware_wifi_print_ip(FILE *f)
 	return ESP_OK;
 }
 
+esp_err_t Hardware_wifi_get_rssi(int *rssi)
+{
+	if (sta_netif == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	wifi_ap_record_t ap = {0};
+	esp_err_t e = esp_wifi_sta_get_ap_info(&ap);
+	if (e != ESP_OK) {
+		return e;
+	}
+	*rssi = ap.rssi;
+	return ESP_OK;
+}
+
 #define DEFAULT_SCAN_LIST_SIZE 20
 
 #define FMT_AP_HEADER "%-40s %5s %5s %-20s %-10s %-10s"
 #define FMT_AP_ROW    "%-40s %5i %5i %-20s %-10s %-10s"
 
-esp_err_t Hardware_wifi_scanap(void)
+esp_err_t Hardware_wifi_scanap(FILE *f)
 {
 	esp_err_t e;
 	uint16_t number = DEFAULT_SCAN_LIST_SIZE;
@@ -260,10 +274,10 @@ esp_err_t Hardware_wifi_scanap(void)
 		ESP_LOGW(__func__, "esp_wifi_scan_get_ap_records() failed, reason = %s", esp_err_to_name(e));
 		return e;
 	}
-	printf("Total APs scanned = %u, actual AP number ap_info holds = %u\n", ap_count, number);
-	printf(FMT_AP_HEADER "\n", "SSID", "RSSI", "Chan", "Authmode", "Pairwise", "Group");
+	fprintf(f, "Total APs scanned = %u, actual AP number ap_info holds = %u\n", ap_count, number);
+	fprintf(f, FMT_AP_HEADER "\n", "SSID", "RSSI", "Chan", "Authmode", "Pairwise", "Group");
 	for (int i = 0; i < number; i++) {
-		printf(FMT_AP_ROW "\n",
+		fprintf(f, FMT_AP_ROW "\n",
 		ap_info[i].ssid,
 		ap_info[i].rssi,
 		ap_info[i].primary,
@@ -1,4 +1,5 @@
 #pragma once
+#include <stdio.h>
 #include <stdbool.h>
 #include <esp_err.h>
 
@@ -9,4 +10,7 @@ esp_err_t Hardware_wifi_connect(const char *ssid, const char *pass, int timeout_
 
 esp_err_t Hardware_wifi_print_ip(FILE *f);
 
-esp_err_t Hardware_wifi_scanap(void);
\ No newline at end of file
+// Signal strength of the AP the station is connected to, fails while not connected
+esp_err_t Hardware_wifi_get_rssi(int *rssi);
+
+esp_err_t Hardware_wifi_scanap(FILE *f);
\ No newline at end of file
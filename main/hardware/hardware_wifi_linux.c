@@ -0,0 +1,45 @@
+#include "hardware_wifi.h"
+
+#include <stdio.h>
+#include <esp_log.h>
+
+// Linux target: the host's network is already up, there is no radio to drive
+
+esp_err_t Hardware_wifi_start()
+{
+	ESP_LOGW(__func__, "no WiFi on the linux target, using the host network");
+	return ESP_OK;
+}
+
+esp_err_t Hardware_wifi_stop()
+{
+	return ESP_OK;
+}
+
+esp_err_t Hardware_wifi_connect(const char *ssid, const char *pw, int timeout_ms)
+{
+	ESP_LOGW(__func__, "no WiFi on the linux target, ignoring ssid '%s'", ssid);
+	return ESP_OK;
+}
+
+esp_err_t Hardware_wifi_disconnect()
+{
+	return ESP_OK;
+}
+
+esp_err_t Hardware_wifi_print_ip(FILE *f)
+{
+	fprintf(f, "IP: host network\n");
+	return ESP_OK;
+}
+
+esp_err_t Hardware_wifi_get_rssi(int *rssi)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t Hardware_wifi_scanap(FILE *f)
+{
+	fprintf(f, "no WiFi on the linux target\n");
+	return ESP_ERR_NOT_SUPPORTED;
+}
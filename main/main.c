@@ -1,15 +1,25 @@
 #include "systems/system_term.h"
 #include "systems/system_web.h"
+#include "systems/system_log.h"
+#include "systems/system_uart.h"
+#include "systems/system_file.h"
+#include "systems/system_udp.h"
+#include "systems/system_metrics.h"
+#include "systems/system_static.h"
 #include "myware/myware_nvs.h"
 #include "hardware/hardware_wifi.h"
 
+#include <stdio.h>
+#include <stdarg.h>
+
+#include <esp_event.h>
+#if !CONFIG_IDF_TARGET_LINUX
 #include <esp_netif.h>
 #include <esp_eth.h>
 #include <esp_wifi.h>
-#include <esp_event.h>
+#endif
 #include <esp_log.h>
 #include <esp_system.h>
-#include <driver/uart.h>
 
 static void setup_wifi_start()
 {
@@ -53,33 +63,20 @@ static void setup_wifi_connect()
 	Hardware_wifi_connect(wifi_ssid, wifi_pw, 0);
 }
 
-system_term_t system_term = {0};
-system_web_t system_web = {0};
+system_log_t system_log = {0};
+// Holds the frame pool and the history, left zeroed so that it goes to .bss, app_main() links it up
+system_web_t system_web;
+system_uart_t system_uart = {.log = &system_log};
+system_file_t system_file = {.log = &system_log};
+system_udp_t system_udp = {.log = &system_log};
+system_term_t system_term = {.web = &system_web, .log = &system_log};
+system_metrics_t system_metrics = {.log = &system_log, .web = &system_web, .uart = &system_uart, .file = &system_file, .udp = &system_udp};
+// Holds the read chunk, linked up in app_main() like system_web
+system_static_t system_static;
 
 int my_vprintf(const char *fmt, va_list args)
 {
-	char buf[1024] = {0};
-	int n = vsnprintf(buf, sizeof(buf), fmt, args);
-	if (n < 0) {
-		return n;
-	}
-	uart_write_bytes(UART_NUM_0, buf, n);
-	if (system_web.rb_tx) {
-		xRingbufferSend(system_web.rb_tx, buf, n, 0);
-		/*
-		char *item;
-		UBaseType_t res;
-		res = xRingbufferSendAcquire(system_web.rb_tx, (void **)&item, n, 0);
-		if (res == pdTRUE) {
-		    res = xRingbufferSendComplete(system_web.rb_tx, &item);
-		    if (res != pdTRUE) {
-		        const char fail[] = "xRingbufferSendComplete failed\n";
-		        uart_write_bytes(UART_NUM_0, fail, sizeof(fail));
-		    }
-		}
-		*/
-	}
-	return n;
+	return system_log_vprintf(&system_log, fmt, args);
 }
 
 static void setup_webserver_start()
@@ -94,25 +91,90 @@ static void setup_webserver_start()
 	if (web_start == false) {
 		return;
 	}
-	system_web_init(&system_web);
-	esp_log_set_vprintf(my_vprintf);
+	if (system_web_init(&system_web) != ESP_OK) {
+		return;
+	}
+	system_metrics_init(&system_metrics);
+	// Last, its wildcard takes every URI left over
+	system_static_init(&system_static);
+}
+
+static void setup_log_file_start()
+{
+	esp_err_t e;
+	bool log_file;
+	e = Myware_nvs_get_bool_verbose("log_file", &log_file);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "Myware_nvs_get_bool_verbose(log_file) failed with %d", e);
+		return;
+	}
+	if (log_file == false) {
+		return;
+	}
+	system_file_init(&system_file);
+}
+
+static void setup_log_udp_start()
+{
+	esp_err_t e;
+	bool log_udp;
+	e = Myware_nvs_get_bool_verbose("log_udp", &log_udp);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "Myware_nvs_get_bool_verbose(log_udp) failed with %d", e);
+		return;
+	}
+	if (log_udp == false) {
+		return;
+	}
+	char log_udp_host[16];
+	uint32_t log_udp_port;
+	e = Myware_nvs_get_str_verbose("log_udp_host", log_udp_host, sizeof(log_udp_host));
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "Myware_nvs_get_str_verbose(log_udp_host) failed with %d", e);
+		return;
+	}
+	e = Myware_nvs_get_u32_verbose("log_udp_port", &log_udp_port);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "Myware_nvs_get_u32_verbose(log_udp_port) failed with %d", e);
+		return;
+	}
+	system_udp_init(&system_udp, log_udp_host, log_udp_port);
 }
 
 void app_main(void)
 {
 	Myware_nvs_init();
+#if !CONFIG_IDF_TARGET_LINUX
 	ESP_ERROR_CHECK(esp_netif_init());
+#endif
 	ESP_ERROR_CHECK(esp_event_loop_create_default());
 
+	// Every log line is formatted once into the router's ring and read by each sink's own task
+	system_log_init(&system_log);
+	system_web.log = &system_log;
+	system_static.web = &system_web;
 	system_term_init(&system_term);
+	system_uart_init(&system_uart);
+	esp_log_set_vprintf(my_vprintf);
 
+#if CONFIG_IDF_TARGET_LINUX
+	// Nothing to wait for on a host, the server is what the linux build is for
+	Myware_nvs_set_bool_verbose("web_start", true, true);
+#else
 	Myware_nvs_set_bool_verbose("web_start", false, true);
+#endif
 	Myware_nvs_set_bool_verbose("wifi_start", false, true);
 	Myware_nvs_set_bool_verbose("wifi_connect", false, true);
 	Myware_nvs_set_str_verbose("wifi_ssid", "<router_ssid>", true);
 	Myware_nvs_set_str_verbose("wifi_pw", "<router_pw>", true);
+	Myware_nvs_set_bool_verbose("log_file", false, true);
+	Myware_nvs_set_bool_verbose("log_udp", false, true);
+	Myware_nvs_set_str_verbose("log_udp_host", "192.168.1.2", true);
+	Myware_nvs_set_u32_verbose("log_udp_port", 5555, true);
 
 	setup_wifi_start();
 	setup_wifi_connect();
 	setup_webserver_start();
+	setup_log_file_start();
+	setup_log_udp_start();
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "myware_heapstat.h"
+
+#include <sdkconfig.h>
+#include <stdatomic.h>
+#include <esp_attr.h>
+#include <esp_log.h>
+#if !CONFIG_IDF_TARGET_LINUX
+#include <esp_heap_caps.h>
+#endif
+#if CONFIG_HEAP_TRACING_STANDALONE
+#include <esp_heap_trace.h>
+#endif
+
+#if CONFIG_IDF_TARGET_LINUX
+// The host's malloc() has no capabilities to walk
+uint32_t Myware_heapstat_fragmentation(uint32_t caps)
+{
+	return 0;
+}
+
+void Myware_heapstat_print(FILE *f)
+{
+	fprintf(f, "heap capabilities are not available on the linux target\n");
+}
+#else
+typedef struct {
+	const char *name;
+	uint32_t caps;
+} private_cap_t;
+
+static const private_cap_t private_caps[] = {
+{"default", MALLOC_CAP_DEFAULT},
+{"internal", MALLOC_CAP_INTERNAL},
+{"8bit", MALLOC_CAP_8BIT},
+{"32bit", MALLOC_CAP_32BIT},
+{"dma", MALLOC_CAP_DMA},
+{"exec", MALLOC_CAP_EXEC},
+{"spiram", MALLOC_CAP_SPIRAM},
+{"rtcram", MALLOC_CAP_RTCRAM},
+};
+
+static uint32_t private_fragmentation(multi_heap_info_t *info)
+{
+	if (info->total_free_bytes == 0) {
+		return 0;
+	}
+	return 1000 - (uint32_t)(((uint64_t)info->largest_free_block * 1000) / info->total_free_bytes);
+}
+
+uint32_t Myware_heapstat_fragmentation(uint32_t caps)
+{
+	multi_heap_info_t info;
+	heap_caps_get_info(&info, caps);
+	return private_fragmentation(&info);
+}
+
+void Myware_heapstat_print(FILE *f)
+{
+	fprintf(f, "%-8s %8s %8s %8s %8s %6s %7s %7s\n", "caps", "size", "free", "min", "largest", "frag", "used", "free");
+	fprintf(f, "%-8s %8s %8s %8s %8s %6s %7s %7s\n", "", "", "", "", "", "", "blocks", "blocks");
+	for (int i = 0; i < sizeof(private_caps) / sizeof(private_caps[0]); i++) {
+		const private_cap_t *cap = &private_caps[i];
+		size_t size = heap_caps_get_total_size(cap->caps);
+		if (size == 0) {
+			continue;
+		}
+		multi_heap_info_t info;
+		heap_caps_get_info(&info, cap->caps);
+		uint32_t frag = private_fragmentation(&info);
+		fprintf(f, "%-8s %8u %8u %8u %8u %3u.%u%% %7u %7u\n", cap->name, (unsigned)size, (unsigned)info.total_free_bytes, (unsigned)info.minimum_free_bytes, (unsigned)info.largest_free_block, (unsigned)(frag / 10), (unsigned)(frag % 10), (unsigned)info.allocated_blocks, (unsigned)info.free_blocks);
+	}
+}
+
+#endif
+
+#if CONFIG_HEAP_USE_HOOKS
+static atomic_uint private_allocs;
+static atomic_uint private_frees;
+static atomic_ullong private_bytes_allocated;
+
+// Called by the allocator for every allocation and free, also with the cache disabled
+IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+	atomic_fetch_add_explicit(&private_allocs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&private_bytes_allocated, size, memory_order_relaxed);
+}
+
+IRAM_ATTR void esp_heap_trace_free_hook(void *ptr)
+{
+	atomic_fetch_add_explicit(&private_frees, 1, memory_order_relaxed);
+}
+
+esp_err_t Myware_heapstat_counts(myware_heapstat_counts_t *counts)
+{
+	counts->allocs = atomic_load_explicit(&private_allocs, memory_order_relaxed);
+	counts->frees = atomic_load_explicit(&private_frees, memory_order_relaxed);
+	counts->bytes_allocated = atomic_load_explicit(&private_bytes_allocated, memory_order_relaxed);
+	return ESP_OK;
+}
+#else
+esp_err_t Myware_heapstat_counts(myware_heapstat_counts_t *counts)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
+
+#if CONFIG_HEAP_TRACING_STANDALONE
+static heap_trace_record_t private_records[CONFIG_MYWARE_HEAPSTAT_TRACE_RECORDS];
+static bool private_trace_init = false;
+
+esp_err_t Myware_heapstat_trace_start(void)
+{
+	esp_err_t e;
+	if (private_trace_init == false) {
+		e = heap_trace_init_standalone(private_records, CONFIG_MYWARE_HEAPSTAT_TRACE_RECORDS);
+		if (e != ESP_OK) {
+			ESP_LOGE(__func__, "heap_trace_init_standalone() failed with %s", esp_err_to_name(e));
+			return e;
+		}
+		private_trace_init = true;
+	}
+	// Only allocations that are still live are kept, each with its callers
+	e = heap_trace_start(HEAP_TRACE_LEAKS);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "heap_trace_start() failed with %s", esp_err_to_name(e));
+		return e;
+	}
+	return ESP_OK;
+}
+
+esp_err_t Myware_heapstat_trace_stop(void)
+{
+	return heap_trace_stop();
+}
+
+esp_err_t Myware_heapstat_trace_dump(void)
+{
+	if (private_trace_init == false) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	heap_trace_dump();
+	return ESP_OK;
+}
+#else
+esp_err_t Myware_heapstat_trace_start(void)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t Myware_heapstat_trace_stop(void)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t Myware_heapstat_trace_dump(void)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stdio.h>
+#include <stdint.h>
+
+// Counted by the heap hooks, needs CONFIG_HEAP_USE_HOOKS
+typedef struct {
+	uint32_t allocs;
+	uint32_t frees;
+	uint64_t bytes_allocated;
+} myware_heapstat_counts_t;
+
+// Free, largest free block, fragmentation and block counts for each memory capability
+void Myware_heapstat_print(FILE *f);
+
+// Fragmentation of the free memory with caps in thousandths, 0 when all of it is one block
+uint32_t Myware_heapstat_fragmentation(uint32_t caps);
+
+// Totals since boot, ESP_ERR_NOT_SUPPORTED without CONFIG_HEAP_USE_HOOKS
+esp_err_t Myware_heapstat_counts(myware_heapstat_counts_t *counts);
+
+// Records the call sites of allocations that are not freed, needs CONFIG_HEAP_TRACING_STANDALONE
+esp_err_t Myware_heapstat_trace_start(void);
+esp_err_t Myware_heapstat_trace_stop(void);
+esp_err_t Myware_heapstat_trace_dump(void);
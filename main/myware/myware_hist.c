@@ -0,0 +1,73 @@
+#include "myware_hist.h"
+
+#include <string.h>
+
+#define SUB (1u << MYWARE_HIST_SUB_BITS)
+
+static uint32_t private_index(uint32_t value)
+{
+	if (value >= (1u << MYWARE_HIST_MAX_BITS)) {
+		value = (1u << MYWARE_HIST_MAX_BITS) - 1;
+	}
+	if (value < SUB) {
+		return value;
+	}
+	uint32_t msb = 31 - __builtin_clz(value);
+	return ((msb - MYWARE_HIST_SUB_BITS + 1) << MYWARE_HIST_SUB_BITS) + ((value >> (msb - MYWARE_HIST_SUB_BITS)) & (SUB - 1));
+}
+
+static uint32_t private_upper(uint32_t index)
+{
+	if (index < SUB) {
+		return index;
+	}
+	uint32_t shift = (index >> MYWARE_HIST_SUB_BITS) - 1;
+	uint32_t low = (SUB + (index & (SUB - 1))) << shift;
+	return low + (1u << shift) - 1;
+}
+
+void Myware_hist_record(myware_hist_t *hist, uint32_t value)
+{
+	hist->counts[private_index(value)]++;
+	if (value > hist->max) {
+		hist->max = value;
+	}
+}
+
+void Myware_hist_reset(myware_hist_t *hist)
+{
+	memset(hist, 0, sizeof(myware_hist_t));
+}
+
+uint32_t Myware_hist_count(myware_hist_t *hist)
+{
+	uint32_t count = 0;
+	for (int i = 0; i < MYWARE_HIST_BUCKETS; i++) {
+		count += hist->counts[i];
+	}
+	return count;
+}
+
+uint32_t Myware_hist_percentile(myware_hist_t *hist, uint32_t permille)
+{
+	uint32_t count = Myware_hist_count(hist);
+	if (count == 0) {
+		return 0;
+	}
+	uint32_t rank = (uint32_t)(((uint64_t)count * permille + 999) / 1000);
+	if (rank == 0) {
+		rank = 1;
+	}
+	uint32_t seen = 0;
+	for (int i = 0; i < MYWARE_HIST_BUCKETS; i++) {
+		seen += hist->counts[i];
+		if (seen >= rank) {
+			if (i == MYWARE_HIST_BUCKETS - 1) {
+				return hist->max;
+			}
+			uint32_t upper = private_upper(i);
+			return (upper < hist->max) ? upper : hist->max;
+		}
+	}
+	return hist->max;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+// Log-linear buckets: values below 8 are exact, above that each power of two has 8 buckets, about 12% wide.
+// Values from 2^27 up land in the last bucket, max still holds them exactly.
+#define MYWARE_HIST_SUB_BITS 3
+#define MYWARE_HIST_MAX_BITS 27
+#define MYWARE_HIST_BUCKETS  ((MYWARE_HIST_MAX_BITS - MYWARE_HIST_SUB_BITS + 1) << MYWARE_HIST_SUB_BITS)
+
+// HDR-style histogram, recorded by one task and read by any
+typedef struct {
+	uint32_t counts[MYWARE_HIST_BUCKETS];
+	uint32_t max;
+} myware_hist_t;
+
+void Myware_hist_record(myware_hist_t *hist, uint32_t value);
+void Myware_hist_reset(myware_hist_t *hist);
+uint32_t Myware_hist_count(myware_hist_t *hist);
+
+// Upper bound of the bucket holding the given quantile, permille is 500 for p50, 990 for p99
+uint32_t Myware_hist_percentile(myware_hist_t *hist, uint32_t permille);
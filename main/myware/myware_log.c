@@ -0,0 +1,382 @@
+#include "myware_log.h"
+
+#include <string.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/param.h>
+
+// Level letters in esp_log_level_t order, starting at ESP_LOG_ERROR
+static const char LEVEL_LETTERS[] = "EWIDV";
+// What LOG_FORMAT() puts between the level letter and the user format
+static const char PREFIX_FMT[] = " (%" PRIu32 ") %s: ";
+static const char SUFFIX_FMT[] = LOG_RESET_COLOR "\n";
+
+#if CONFIG_MYWARE_LOG_TRACE_DEFAULT
+static bool private_trace = true;
+#else
+static bool private_trace = false;
+#endif
+
+bool Myware_log_parse(const char *fmt, va_list *args, myware_log_meta_t *meta)
+{
+	const char *p = fmt;
+	size_t color_len = 0;
+	if (p[0] == '\033') {
+		const char *m = strchr(p, 'm');
+		if (m == NULL) {
+			return false;
+		}
+		color_len = m - p + 1;
+		p = m + 1;
+	}
+	if (p[0] == '\0') {
+		return false;
+	}
+	const char *letter = strchr(LEVEL_LETTERS, p[0]);
+	if (letter == NULL) {
+		return false;
+	}
+	p++;
+	if (strncmp(p, PREFIX_FMT, sizeof(PREFIX_FMT) - 1) != 0) {
+		return false;
+	}
+	meta->level = ESP_LOG_ERROR + (letter - LEVEL_LETTERS);
+	meta->body_fmt = p + sizeof(PREFIX_FMT) - 1;
+	meta->timestamp = va_arg(*args, uint32_t);
+	meta->tag = va_arg(*args, const char *);
+	if (meta->tag == NULL) {
+		return false;
+	}
+
+	// color + letter + " (" + timestamp + ") " + tag + ": "
+	int digits = snprintf(NULL, 0, "%" PRIu32, meta->timestamp);
+	meta->prefix_len = color_len + 1 + 2 + digits + 2 + strlen(meta->tag) + 2;
+
+	size_t fmt_len = strlen(meta->body_fmt);
+	size_t suffix_len = sizeof(SUFFIX_FMT) - 1;
+	if (fmt_len >= suffix_len && strcmp(meta->body_fmt + fmt_len - suffix_len, SUFFIX_FMT) == 0) {
+		meta->suffix_len = suffix_len;
+	} else if (fmt_len >= 1 && meta->body_fmt[fmt_len - 1] == '\n') {
+		meta->suffix_len = 1;
+	} else {
+		meta->suffix_len = 0;
+	}
+	return true;
+}
+
+// Where the encoding goes, a buffer or an FNV-1a hash of every byte
+typedef struct {
+	uint8_t *out;
+	size_t out_size;
+	size_t n;
+	// Hashing takes strings whole instead of cut to 255 chars
+	bool hash;
+	uint32_t value;
+} private_writer_t;
+
+static void private_put(private_writer_t *w, const void *data, size_t len)
+{
+	if (w->hash) {
+		const uint8_t *bytes = data;
+		for (size_t i = 0; i < len; i++) {
+			w->value = (w->value ^ bytes[i]) * 16777619u;
+		}
+	} else if (w->out != NULL && (w->n + len) <= w->out_size) {
+		memcpy(w->out + w->n, data, len);
+	}
+	w->n += len;
+}
+
+static void private_encode(private_writer_t *w, const char *fmt, va_list *args)
+{
+	uint32_t addr = (uint32_t)(uintptr_t)fmt;
+	private_put(w, &addr, sizeof(addr));
+	const char *p = fmt;
+	while ((p = strchr(p, '%')) != NULL) {
+		p++;
+		while (*p != '\0' && strchr("-+ #0", *p)) {
+			p++;
+		}
+		// Width and precision given as arguments
+		for (int i = 0; i < 2; i++) {
+			if (*p == '*') {
+				int32_t value = va_arg(*args, int);
+				private_put(w, &value, sizeof(value));
+				p++;
+			}
+			while (*p >= '0' && *p <= '9') {
+				p++;
+			}
+			if (i == 0 && *p == '.') {
+				p++;
+			}
+		}
+		int longs = 0;
+		bool long_double = false;
+		while (*p != '\0' && strchr("hlLqjzt", *p)) {
+			longs += (*p == 'l') ? 1 : (*p == 'q' || *p == 'j') ? 2 : 0;
+			long_double |= (*p == 'L');
+			p++;
+		}
+		switch (*p) {
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+		case 'c':
+			if (longs >= 2) {
+				uint64_t value = va_arg(*args, uint64_t);
+				private_put(w, &value, sizeof(value));
+			} else {
+				uint32_t value = va_arg(*args, uint32_t);
+				private_put(w, &value, sizeof(value));
+			}
+			break;
+		case 'p': {
+			uint32_t value = (uint32_t)(uintptr_t)va_arg(*args, void *);
+			private_put(w, &value, sizeof(value));
+		} break;
+		case 's': {
+			const char *str = va_arg(*args, const char *);
+			if (str == NULL) {
+				str = "(null)";
+			}
+			size_t str_len = strlen(str);
+			uint8_t len = MIN(str_len, 255);
+			private_put(w, &len, sizeof(len));
+			private_put(w, str, w->hash ? str_len : len);
+		} break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A': {
+			double value = long_double ? (double)va_arg(*args, long double) : va_arg(*args, double);
+			private_put(w, &value, sizeof(value));
+		} break;
+		case '\0':
+			return;
+		default:
+			// %% and unsupported conversions carry no argument
+			break;
+		}
+		p++;
+	}
+}
+
+size_t Myware_log_trace(uint8_t *out, size_t out_size, const char *fmt, va_list *args)
+{
+	private_writer_t w = {.out = out, .out_size = out_size};
+	private_encode(&w, fmt, args);
+	return w.n;
+}
+
+uint32_t Myware_log_fingerprint(const char *fmt, va_list *args)
+{
+	private_writer_t w = {.hash = true, .value = 2166136261u};
+	private_encode(&w, fmt, args);
+	return w.value;
+}
+
+static bool private_take(const uint8_t *args, size_t args_len, size_t *pos, void *out, size_t len)
+{
+	if ((*pos + len) > args_len) {
+		return false;
+	}
+	memcpy(out, args + *pos, len);
+	*pos += len;
+	return true;
+}
+
+static void private_append(char *out, size_t out_size, size_t *n, int len)
+{
+	// snprintf() was given what is left of out, *n stops at the terminating NUL
+	if (len > 0) {
+		*n = MIN(*n + len, out_size - 1);
+	}
+}
+
+size_t Myware_log_format(char *out, size_t out_size, const char *fmt, const uint8_t *args, size_t args_len)
+{
+	if (out_size == 0) {
+		return 0;
+	}
+	out[0] = '\0';
+	size_t n = 0;
+	size_t pos = 0;
+	const char *p = fmt;
+	while (*p != '\0' && n < (out_size - 1)) {
+		if (*p != '%') {
+			const char *next = strchr(p, '%');
+			size_t len = next ? (size_t)(next - p) : strlen(p);
+			len = MIN(len, out_size - 1 - n);
+			memcpy(out + n, p, len);
+			n += len;
+			out[n] = '\0';
+			p += len;
+			continue;
+		}
+		// The conversion is rebuilt for the sizes Myware_log_trace() stored, "*" becomes the stored number
+		char spec[32];
+		size_t spec_len = 0;
+		spec[spec_len++] = *p++;
+		while (*p != '\0' && strchr("-+ #0", *p)) {
+			if (spec_len < 8) {
+				spec[spec_len++] = *p;
+			}
+			p++;
+		}
+		for (int i = 0; i < 2; i++) {
+			if (*p == '*') {
+				int32_t value;
+				if (private_take(args, args_len, &pos, &value, sizeof(value)) == false) {
+					return n;
+				}
+				if (spec_len < 20) {
+					spec_len += MIN(snprintf(spec + spec_len, 21 - spec_len, "%" PRIi32, value), 20 - (int)spec_len);
+				}
+				p++;
+			}
+			while (*p >= '0' && *p <= '9') {
+				if (spec_len < 20) {
+					spec[spec_len++] = *p;
+				}
+				p++;
+			}
+			if (i == 0 && *p == '.') {
+				spec[spec_len++] = *p++;
+			}
+		}
+		int longs = 0;
+		// Only h and hh are kept, the stored sizes decide the rest
+		while (*p != '\0' && strchr("hlLqjzt", *p)) {
+			longs += (*p == 'l') ? 1 : (*p == 'q' || *p == 'j') ? 2 : 0;
+			if (*p == 'h' && spec_len < 24) {
+				spec[spec_len++] = 'h';
+			}
+			p++;
+		}
+		char conv = *p;
+		if (conv == '\0') {
+			break;
+		}
+		p++;
+		char *rest = out + n;
+		size_t rest_size = out_size - n;
+		switch (conv) {
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+		case 'c':
+			if (longs >= 2 && conv != 'c') {
+				uint64_t value;
+				if (private_take(args, args_len, &pos, &value, sizeof(value)) == false) {
+					return n;
+				}
+				spec[spec_len++] = 'l';
+				spec[spec_len++] = 'l';
+				spec[spec_len++] = conv;
+				spec[spec_len] = '\0';
+				if (conv == 'd' || conv == 'i') {
+					private_append(out, out_size, &n, snprintf(rest, rest_size, spec, (long long)value));
+				} else {
+					private_append(out, out_size, &n, snprintf(rest, rest_size, spec, (unsigned long long)value));
+				}
+			} else {
+				uint32_t value;
+				if (private_take(args, args_len, &pos, &value, sizeof(value)) == false) {
+					return n;
+				}
+				spec[spec_len++] = conv;
+				spec[spec_len] = '\0';
+				if (conv == 'd' || conv == 'i' || conv == 'c') {
+					private_append(out, out_size, &n, snprintf(rest, rest_size, spec, (int)value));
+				} else {
+					private_append(out, out_size, &n, snprintf(rest, rest_size, spec, (unsigned int)value));
+				}
+			}
+			break;
+		case 'p': {
+			uint32_t value;
+			if (private_take(args, args_len, &pos, &value, sizeof(value)) == false) {
+				return n;
+			}
+			private_append(out, out_size, &n, snprintf(rest, rest_size, "0x%08" PRIx32, value));
+		} break;
+		case 's': {
+			uint8_t len;
+			char str[256];
+			if (private_take(args, args_len, &pos, &len, sizeof(len)) == false || private_take(args, args_len, &pos, str, len) == false) {
+				return n;
+			}
+			str[len] = '\0';
+			spec[spec_len++] = 's';
+			spec[spec_len] = '\0';
+			private_append(out, out_size, &n, snprintf(rest, rest_size, spec, str));
+		} break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A': {
+			double value;
+			if (private_take(args, args_len, &pos, &value, sizeof(value)) == false) {
+				return n;
+			}
+			spec[spec_len++] = conv;
+			spec[spec_len] = '\0';
+			private_append(out, out_size, &n, snprintf(rest, rest_size, spec, value));
+		} break;
+		case '%':
+			out[n++] = '%';
+			out[n] = '\0';
+			break;
+		default:
+			// Unsupported conversions carry no argument, they are left out
+			break;
+		}
+	}
+	return n;
+}
+
+void Myware_log_set_trace(bool enabled)
+{
+	private_trace = enabled;
+}
+
+bool Myware_log_get_trace(void)
+{
+	return private_trace;
+}
+
+static const char *private_level_str[] = {"none", "error", "warn", "info", "debug", "verbose"};
+
+const char *Myware_log_level_str(uint8_t level)
+{
+	if (level >= sizeof(private_level_str) / sizeof(private_level_str[0])) {
+		return "?";
+	}
+	return private_level_str[level];
+}
+
+bool Myware_log_level_parse(const char *str, uint8_t *level)
+{
+	for (uint8_t i = 0; i < sizeof(private_level_str) / sizeof(private_level_str[0]); i++) {
+		if (strcmp(str, private_level_str[i]) == 0) {
+			*level = i;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <esp_log.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// What an ESP_LOGx line carries besides its formatted text
+typedef struct {
+	esp_log_level_t level;
+	uint32_t timestamp;
+	const char *tag;
+	// Format of the message body, points into the original format string
+	const char *body_fmt;
+	// Length of the formatted "I (123) tag: " prefix including the color escape
+	size_t prefix_len;
+	// Length of the reset color escape and newline after the body
+	size_t suffix_len;
+} myware_log_meta_t;
+
+// Parses the LOG_FORMAT() prefix that ESP_LOGx puts in front of every format string.
+// Consumes the timestamp and tag from *args, which then hold the body arguments. Returns false for other lines.
+bool Myware_log_parse(const char *fmt, va_list *args, myware_log_meta_t *meta);
+
+// Encodes a line for host side formatting: the address of fmt followed by the raw arguments.
+// Integers are 4 bytes or 8 for ll/j, floats are 8 byte doubles, %s is a length byte and up to 255 chars.
+// All little endian. Writes at most out_size bytes and returns the full encoded size, out may be NULL to measure.
+size_t Myware_log_trace(uint8_t *out, size_t out_size, const char *fmt, va_list *args);
+
+// Hash of the same encoding without a buffer, strings are hashed whole. Identifies a message without formatting it.
+uint32_t Myware_log_fingerprint(const char *fmt, va_list *args);
+
+// Formats a Myware_log_trace() payload on the device, for records that were stored unformatted and are read after all.
+// args is the payload after the address, fmt the format it was encoded with. Returns the length written to out, cut to out_size - 1.
+size_t Myware_log_format(char *out, size_t out_size, const char *fmt, const uint8_t *args, size_t args_len);
+
+// Trace mode: ESP_LOGx lines above CONFIG_MYWARE_LOG_TRACE_UART_LEVEL skip formatting on the device
+void Myware_log_set_trace(bool enabled);
+bool Myware_log_get_trace(void);
+
+// Level names used by the console: none, error, warn, info, debug, verbose
+const char *Myware_log_level_str(uint8_t level);
+bool Myware_log_level_parse(const char *str, uint8_t *level);
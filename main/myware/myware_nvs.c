@@ -1,6 +1,7 @@
 #include <nvs_flash.h>
 #include <esp_log.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include "myware_nvs.h"
 
@@ -8,7 +9,7 @@ static uint32_t private_nvs;
 
 #define LOG_FAIL(fname, e)          ESP_LOGW("Myware::NVS", "%s() failed, reason = %s", (fname), esp_err_to_name((e)));
 #define LOG_BOOL(fname, key, value) ESP_LOGI("Myware::NVS", "%s(): %s: %s", (fname), (key), (value) ? "true" : "false");
-#define LOG_U32(fname, key, value)  ESP_LOGI("Myware::NVS", "%s(): %s: %li", (fname), (key), (value));
+#define LOG_U32(fname, key, value)  ESP_LOGI("Myware::NVS", "%s(): %s: %" PRIu32, (fname), (key), (value));
 #define LOG_U8(fname, key, value)   ESP_LOGI("Myware::NVS", "%s(): %s: %i", (fname), (key), (int)(value));
 #define LOG_STR(fname, key, value)  ESP_LOGI("Myware::NVS", "%s(): %s: %s", (fname), (key), (value));
 
@@ -30,12 +31,12 @@ esp_err_t Myware_nvs_set_u32_verbose(char const *key, uint32_t value, bool ignor
 	uint32_t value0 = 0;
 	e = nvs_get_u32(private_nvs, key, &value0);
 	if (e == ESP_OK) {
-		ESP_LOGI(__func__, "NVS-get: storage: %s: %li", key, value0);
+		ESP_LOGI(__func__, "NVS-get: storage: %s: %" PRIu32, key, value0);
 		if (ignore_if_exist) {
 			return e;
 		}
 	}
-	ESP_LOGI(__func__, "NVS-set: storage: %s: %li", key, value);
+	ESP_LOGI(__func__, "NVS-set: storage: %s: %" PRIu32, key, value);
 	e = nvs_set_u32(private_nvs, key, value);
 	if (e != ESP_OK) {
 		LOG_FAIL("nvs_set_u32", e);
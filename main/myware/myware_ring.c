@@ -0,0 +1,351 @@
+#include "myware_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <esp_log.h>
+
+// Every record starts with a 4 byte header holding the data length and these flags.
+// Space behind the slowest reader is zeroed, so a header that is not committed yet always reads as 0 or a bare length.
+#define RING_COMMIT 0x80000000u
+#define RING_PAD    0x40000000u
+#define RING_LEN    0x3FFFFFFFu
+#define RING_HEADER sizeof(atomic_uint)
+// In a reader's pos, records are 4 byte aligned so the low bits are free
+#define RING_CLAIM  1u
+
+static inline uint32_t private_align(size_t len)
+{
+	return (len + 3) & ~3u;
+}
+
+static inline atomic_uint *private_header(myware_ring_t *ring, uint32_t pos)
+{
+	return (atomic_uint *)(ring->buf + (pos & (ring->size - 1)));
+}
+
+esp_err_t Myware_ring_init(myware_ring_t *ring, uint32_t size)
+{
+	if (size < 64 || (size & (size - 1)) != 0) {
+		ESP_LOGE(__func__, "size %u is not a power of two", (unsigned)size);
+		return ESP_ERR_INVALID_ARG;
+	}
+	uint8_t *buf = calloc(1, size);
+	if (buf == NULL) {
+		ESP_LOGE(__func__, "calloc() failed");
+		return ESP_ERR_NO_MEM;
+	}
+	ring->size = size;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+	atomic_init(&ring->dropped, 0);
+	atomic_init(&ring->readers_len, 0);
+	atomic_flag_clear(&ring->tail_lock);
+	// Loggers check buf, it is set last
+	atomic_thread_fence(memory_order_release);
+	ring->buf = buf;
+	return ESP_OK;
+}
+
+size_t Myware_ring_max_size(myware_ring_t *ring)
+{
+	// A record of half the ring always fits once the ring is empty, wherever the head is
+	return ring->size / 2 - RING_HEADER;
+}
+
+size_t Myware_ring_used(myware_ring_t *ring)
+{
+	return atomic_load(&ring->head) - atomic_load(&ring->tail);
+}
+
+static uint32_t private_record_size(uint32_t value)
+{
+	return private_align(RING_HEADER + (value & RING_LEN));
+}
+
+static void private_zero(myware_ring_t *ring, uint32_t from, uint32_t to)
+{
+	uint32_t offset = from & (ring->size - 1);
+	uint32_t len = to - from;
+	uint32_t first = (len < ring->size - offset) ? len : (ring->size - offset);
+	memset(ring->buf + offset, 0, first);
+	memset(ring->buf, 0, len - first);
+}
+
+static void private_tail_advance(myware_ring_t *ring)
+{
+	// The reader holding tail_lock rechecks after letting go, so a release that found it taken is not lost
+	while (atomic_flag_test_and_set(&ring->tail_lock) == false) {
+		uint32_t tail = atomic_load(&ring->tail);
+		uint32_t slowest = atomic_load(&ring->head) - tail;
+		int len = atomic_load(&ring->readers_len);
+		for (int i = 0; i < len; i++) {
+			uint32_t behind = (atomic_load(&ring->readers[i].pos) & ~RING_CLAIM) - tail;
+			slowest = (behind < slowest) ? behind : slowest;
+		}
+		if (slowest > 0) {
+			// Uncommitted headers must read as 0 when the space is reserved again
+			private_zero(ring, tail, tail + slowest);
+			atomic_store(&ring->tail, tail + slowest);
+		}
+		atomic_flag_clear(&ring->tail_lock);
+		if (slowest == 0) {
+			break;
+		}
+	}
+}
+
+static void private_count_skipped(myware_ring_t *ring, myware_ring_reader_t *reader, uint32_t from, uint32_t to)
+{
+	uint32_t records = 0;
+	uint32_t bytes = 0;
+	for (uint32_t pos = from; (int32_t)(to - pos) > 0;) {
+		atomic_uint *header = private_header(ring, pos);
+		uint32_t value = atomic_load_explicit(header, memory_order_relaxed);
+		if ((value & RING_PAD) == 0 && (reader->filter == NULL || reader->filter((uint8_t *)header + RING_HEADER, value & RING_LEN, reader->filter_context))) {
+			records++;
+			bytes += value & RING_LEN;
+		}
+		pos += private_record_size(value);
+	}
+	atomic_fetch_add(&reader->skipped, records);
+	atomic_fetch_add(&reader->skipped_bytes, bytes);
+}
+
+static bool private_skip(myware_ring_t *ring, uint32_t want)
+{
+	// A reserve that does not fit moves lossy readers past their oldest records until the tail can reach want.
+	// Never past a record that is not committed, a reader that is not lossy or a record a lossy reader holds.
+	if (atomic_flag_test_and_set(&ring->tail_lock)) {
+		return false;
+	}
+	uint32_t tail = atomic_load(&ring->tail);
+	uint32_t head = atomic_load(&ring->head);
+	uint32_t to = tail;
+	while ((int32_t)(want - to) > 0 && to != head) {
+		uint32_t value = atomic_load_explicit(private_header(ring, to), memory_order_acquire);
+		if ((value & RING_COMMIT) == 0) {
+			break;
+		}
+		to += private_record_size(value);
+	}
+	int len = atomic_load(&ring->readers_len);
+	for (int i = 0; i < len; i++) {
+		myware_ring_reader_t *reader = &ring->readers[i];
+		uint32_t pos = atomic_load(&reader->pos);
+		if (atomic_load(&reader->lossy) == false || (pos & RING_CLAIM)) {
+			pos &= ~RING_CLAIM;
+			to = ((pos - tail) < (to - tail)) ? pos : to;
+		}
+	}
+	for (int i = 0; i < len; i++) {
+		myware_ring_reader_t *reader = &ring->readers[i];
+		if (atomic_load(&reader->lossy) == false) {
+			continue;
+		}
+		uint32_t pos = atomic_load(&reader->pos);
+		while (((pos & ~RING_CLAIM) - tail) < (to - tail)) {
+			if (pos & RING_CLAIM) {
+				// It claimed a record since the pass above, the skip stops there
+				to = pos & ~RING_CLAIM;
+				break;
+			}
+			// A reader that already moved lost records still in the ring, it is ahead of the tail from now on
+			if (atomic_compare_exchange_weak(&reader->pos, &pos, to)) {
+				private_count_skipped(ring, reader, pos, to);
+				break;
+			}
+		}
+	}
+	bool moved = (to != tail);
+	if (moved) {
+		private_zero(ring, tail, to);
+		atomic_store(&ring->tail, to);
+	}
+	atomic_flag_clear(&ring->tail_lock);
+	private_tail_advance(ring);
+	return moved;
+}
+
+void *Myware_ring_reserve(myware_ring_t *ring, size_t len)
+{
+	if (len > Myware_ring_max_size(ring)) {
+		atomic_fetch_add(&ring->dropped, 1);
+		return NULL;
+	}
+	uint32_t need = private_align(RING_HEADER + len);
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	uint32_t pad;
+	bool skipped = false;
+	while (1) {
+		uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		uint32_t offset = head & (ring->size - 1);
+		// Records never wrap, the end of the buffer is skipped with a padding record instead
+		pad = (offset + need > ring->size) ? (ring->size - offset) : 0;
+		if ((head + pad + need - tail) > ring->size) {
+			// Once per reserve, lossy readers that are behind make room
+			if (skipped == false) {
+				skipped = true;
+				if (private_skip(ring, head + pad + need - ring->size)) {
+					head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+					continue;
+				}
+			}
+			atomic_fetch_add(&ring->dropped, 1);
+			return NULL;
+		}
+		// Release, so that a reader seeing the new head also sees the space zeroed before the tail moved past it
+		if (atomic_compare_exchange_weak_explicit(&ring->head, &head, head + pad + need, memory_order_release, memory_order_relaxed)) {
+			break;
+		}
+	}
+	if (pad) {
+		atomic_store_explicit(private_header(ring, head), RING_COMMIT | RING_PAD | (pad - RING_HEADER), memory_order_release);
+	}
+	atomic_uint *header = private_header(ring, head + pad);
+	atomic_store_explicit(header, len, memory_order_relaxed);
+	return (uint8_t *)header + RING_HEADER;
+}
+
+static void private_publish(myware_ring_t *ring, void *data)
+{
+	atomic_uint *header = (atomic_uint *)((uint8_t *)data - RING_HEADER);
+	uint32_t value = atomic_load_explicit(header, memory_order_relaxed);
+	atomic_store_explicit(header, value | RING_COMMIT, memory_order_release);
+}
+
+static void private_notify(myware_ring_t *ring, BaseType_t *woken)
+{
+	// Only the producer that finds a reader asleep pays for the notification
+	int len = atomic_load(&ring->readers_len);
+	for (int i = 0; i < len; i++) {
+		myware_ring_reader_t *reader = &ring->readers[i];
+		if (atomic_exchange(&reader->waiting, false) == false) {
+			continue;
+		}
+		if (woken != NULL) {
+			vTaskNotifyGiveFromISR(reader->task, woken);
+		} else {
+			xTaskNotifyGive(reader->task);
+		}
+	}
+}
+
+void Myware_ring_commit(myware_ring_t *ring, void *data)
+{
+	private_publish(ring, data);
+	private_notify(ring, NULL);
+}
+
+void Myware_ring_commit_isr(myware_ring_t *ring, void *data, BaseType_t *woken)
+{
+	private_publish(ring, data);
+	private_notify(ring, woken);
+}
+
+int Myware_ring_reader_add(myware_ring_t *ring)
+{
+	while (atomic_flag_test_and_set(&ring->tail_lock)) {
+		vTaskDelay(1);
+	}
+	int index = atomic_load(&ring->readers_len);
+	if (index < MYWARE_RING_READERS_MAX) {
+		myware_ring_reader_t *reader = &ring->readers[index];
+		atomic_store(&reader->pos, atomic_load(&ring->head));
+		atomic_store(&reader->waiting, false);
+		atomic_store(&reader->lossy, false);
+		atomic_store(&reader->skipped, 0);
+		atomic_store(&reader->skipped_bytes, 0);
+		reader->filter = NULL;
+		reader->task = NULL;
+		atomic_store(&ring->readers_len, index + 1);
+	} else {
+		index = -1;
+	}
+	atomic_flag_clear(&ring->tail_lock);
+	return index;
+}
+
+static void *private_peek(myware_ring_t *ring, myware_ring_reader_t *reader, size_t *len)
+{
+	uint32_t pos = atomic_load(&reader->pos);
+	while (1) {
+		if (pos == atomic_load_explicit(&ring->head, memory_order_acquire)) {
+			return NULL;
+		}
+		// Claimed before the header is read, a reserve that runs out of space does not skip a lossy reader past it
+		if (atomic_compare_exchange_weak(&reader->pos, &pos, pos | RING_CLAIM) == false) {
+			continue;
+		}
+		atomic_uint *header = private_header(ring, pos);
+		uint32_t value = atomic_load_explicit(header, memory_order_acquire);
+		if ((value & RING_COMMIT) == 0) {
+			atomic_store(&reader->pos, pos);
+			return NULL;
+		}
+		if (value & RING_PAD) {
+			pos += private_record_size(value);
+			atomic_store(&reader->pos, pos);
+			continue;
+		}
+		*len = value & RING_LEN;
+		return (uint8_t *)header + RING_HEADER;
+	}
+}
+
+void *Myware_ring_receive(myware_ring_t *ring, int index, size_t *len, TickType_t timeout)
+{
+	myware_ring_reader_t *reader = &ring->readers[index];
+	TickType_t start = xTaskGetTickCount();
+	while (1) {
+		void *data = private_peek(ring, reader, len);
+		if (data != NULL) {
+			return data;
+		}
+		TickType_t elapsed = xTaskGetTickCount() - start;
+		if (elapsed >= timeout) {
+			return NULL;
+		}
+		reader->task = xTaskGetCurrentTaskHandle();
+		atomic_store(&reader->waiting, true);
+		// A commit between the peek above and setting waiting did not notify
+		data = private_peek(ring, reader, len);
+		if (data != NULL) {
+			atomic_store(&reader->waiting, false);
+			return data;
+		}
+		ulTaskNotifyTake(pdTRUE, timeout - elapsed);
+		atomic_store(&reader->waiting, false);
+	}
+}
+
+void Myware_ring_release(myware_ring_t *ring, int index, void *data)
+{
+	atomic_uint *header = (atomic_uint *)((uint8_t *)data - RING_HEADER);
+	uint32_t value = atomic_load_explicit(header, memory_order_relaxed);
+	myware_ring_reader_t *reader = &ring->readers[index];
+	// Nothing else moves a reader while it holds a record
+	uint32_t pos = atomic_load(&reader->pos) & ~RING_CLAIM;
+	atomic_store(&reader->pos, pos + private_record_size(value));
+	private_tail_advance(ring);
+}
+
+void Myware_ring_reader_set_lossy(myware_ring_t *ring, int index, bool lossy)
+{
+	atomic_store(&ring->readers[index].lossy, lossy);
+}
+
+void Myware_ring_reader_set_filter(myware_ring_t *ring, int index, myware_ring_filter_t filter, void *context)
+{
+	myware_ring_reader_t *reader = &ring->readers[index];
+	reader->filter_context = context;
+	reader->filter = filter;
+}
+
+uint32_t Myware_ring_reader_skipped(myware_ring_t *ring, int index, uint32_t *bytes)
+{
+	myware_ring_reader_t *reader = &ring->readers[index];
+	if (bytes != NULL) {
+		*bytes = atomic_exchange(&reader->skipped_bytes, 0);
+	}
+	return atomic_exchange(&reader->skipped, 0);
+}
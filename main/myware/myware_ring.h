@@ -0,0 +1,79 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_err.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MYWARE_RING_READERS_MAX 8
+
+// Whether a skipped record counts for the reader, for readers that ignore some records
+typedef bool (*myware_ring_filter_t)(const void *data, size_t len, void *context);
+
+// One consumer of the ring, reading every record at its own position
+typedef struct {
+	// Byte position of the next record, bit 0 is set while the reader looks at or holds the record there
+	atomic_uint pos;
+	// Gives up the records it has not read yet when the ring is full, instead of holding back the tail
+	atomic_bool lossy;
+	// Records and bytes a lossy reader lost that way, taken by Myware_ring_reader_skipped()
+	atomic_uint skipped;
+	atomic_uint skipped_bytes;
+	// NULL counts every skipped record
+	myware_ring_filter_t filter;
+	void *filter_context;
+	// Set while the reader sleeps, the committing producer that clears it notifies the reader
+	atomic_bool waiting;
+	// Task that called Myware_ring_receive() for this reader
+	TaskHandle_t task;
+} myware_ring_reader_t;
+
+// Lock-free byte ring with many producers and up to MYWARE_RING_READERS_MAX readers.
+// Producers reserve a record with one compare-and-swap, fill it in place and commit it.
+// Every reader sees every record in reservation order, a reserved but uncommitted record holds back the ones after it.
+// Space is reused once the slowest reader is past it. When that is a lossy reader, a reserve that does not fit
+// moves it past its oldest unread records instead, only the record it holds stays.
+// Reserve and commit never block. Reserve can be called from any task or ISR, commit wakes a sleeping reader with a
+// task notification: Myware_ring_commit_isr() from an ISR, never inside a critical section or with interrupts disabled.
+typedef struct {
+	uint8_t *buf;
+	// Power of two
+	uint32_t size;
+	// Free running byte positions, head is advanced by producers, tail follows the slowest reader
+	atomic_uint head;
+	atomic_uint tail;
+	// Taken by the reader that zeroes released space and moves the tail
+	atomic_flag tail_lock;
+	myware_ring_reader_t readers[MYWARE_RING_READERS_MAX];
+	atomic_int readers_len;
+	// Records that did not fit
+	atomic_uint dropped;
+} myware_ring_t;
+
+esp_err_t Myware_ring_init(myware_ring_t *ring, uint32_t size);
+
+// Largest record that can always be reserved
+size_t Myware_ring_max_size(myware_ring_t *ring);
+
+// Bytes reserved and not yet released by every reader
+size_t Myware_ring_used(myware_ring_t *ring);
+
+// Returns NULL and counts a drop when the ring is full. The record is 4 byte aligned.
+void *Myware_ring_reserve(myware_ring_t *ring, size_t len);
+void Myware_ring_commit(myware_ring_t *ring, void *data);
+void Myware_ring_commit_isr(myware_ring_t *ring, void *data, BaseType_t *woken);
+
+// Adds a reader that starts at the next record reserved, returns its index or -1 when there are too many
+int Myware_ring_reader_add(myware_ring_t *ring);
+void Myware_ring_reader_set_lossy(myware_ring_t *ring, int reader, bool lossy);
+// Set before the reader's records are reserved, called from reserve and so possibly from an ISR
+void Myware_ring_reader_set_filter(myware_ring_t *ring, int reader, myware_ring_filter_t filter, void *context);
+// Records a lossy reader lost since the last call, *bytes gets their size
+uint32_t Myware_ring_reader_skipped(myware_ring_t *ring, int reader, uint32_t *bytes);
+
+// Reader side, each reader index is only used by its own task
+void *Myware_ring_receive(myware_ring_t *ring, int reader, size_t *len, TickType_t timeout);
+void Myware_ring_release(myware_ring_t *ring, int reader, void *data);
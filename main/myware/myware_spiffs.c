@@ -0,0 +1,41 @@
+#include "myware_spiffs.h"
+
+#include <sdkconfig.h>
+#include <stdbool.h>
+#include <esp_log.h>
+#if !CONFIG_IDF_TARGET_LINUX
+#include <esp_spiffs.h>
+#endif
+
+static bool private_mounted = false;
+
+esp_err_t Myware_spiffs_mount(void)
+{
+	if (private_mounted) {
+		return ESP_OK;
+	}
+#if CONFIG_IDF_TARGET_LINUX
+	ESP_LOGW(__func__, "no SPIFFS on the linux target");
+	return ESP_ERR_NOT_SUPPORTED;
+#else
+	esp_vfs_spiffs_conf_t conf = {
+	.base_path = MYWARE_SPIFFS_BASE_PATH,
+	.partition_label = "storage",
+	.max_files = 5,
+	.format_if_mount_failed = true,
+	};
+	esp_err_t e = esp_vfs_spiffs_register(&conf);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "esp_vfs_spiffs_register() failed with %s", esp_err_to_name(e));
+		return e;
+	}
+	size_t total = 0;
+	size_t used = 0;
+	e = esp_spiffs_info(conf.partition_label, &total, &used);
+	if (e == ESP_OK) {
+		ESP_LOGI(__func__, "%s: %u of %u bytes used", MYWARE_SPIFFS_BASE_PATH, (unsigned)used, (unsigned)total);
+	}
+	private_mounted = true;
+	return ESP_OK;
+#endif
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <esp_err.h>
+
+// Where the "storage" partition is mounted
+#define MYWARE_SPIFFS_BASE_PATH "/storage"
+
+// Mounts the "storage" SPIFFS partition, formatting it if it cannot be mounted. Safe to call more than once.
+esp_err_t Myware_spiffs_mount(void);
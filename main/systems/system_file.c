@@ -0,0 +1,74 @@
+#include "system_file.h"
+#include "myware/myware_spiffs.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+#define FILE_LOG_OLD CONFIG_SYSTEM_FILE_LOG_PATH ".old"
+
+static FILE *private_open(size_t *size)
+{
+	FILE *f = fopen(CONFIG_SYSTEM_FILE_LOG_PATH, "a");
+	if (f == NULL) {
+		return NULL;
+	}
+	struct stat st;
+	*size = (stat(CONFIG_SYSTEM_FILE_LOG_PATH, &st) == 0) ? st.st_size : 0;
+	return f;
+}
+
+static void private_task_my_file(system_file_t *system)
+{
+	assert(system != NULL);
+	size_t size = 0;
+	FILE *f = private_open(&size);
+	bool dirty = false;
+	while (1) {
+		// Flushing once a second keeps flash writes few, a crash loses at most that second
+		system_log_record_t *record = system_log_receive(system->log, &system->sink, pdMS_TO_TICKS(1000));
+		if (record == NULL) {
+			if (f != NULL && dirty) {
+				fflush(f);
+				dirty = false;
+			}
+			continue;
+		}
+		if (f != NULL && fwrite(record->text, 1, record->text_len, f) == record->text_len) {
+			size += record->text_len;
+			dirty = true;
+			atomic_fetch_add(&system->bytes_written, record->text_len);
+		}
+		system_log_release(system->log, &system->sink, record);
+		if (f != NULL && size >= CONFIG_SYSTEM_FILE_LOG_MAX) {
+			// Keep the current and the previous file
+			fclose(f);
+			remove(FILE_LOG_OLD);
+			rename(CONFIG_SYSTEM_FILE_LOG_PATH, FILE_LOG_OLD);
+			f = private_open(&size);
+			dirty = false;
+			atomic_fetch_add(&system->rotations, 1);
+		}
+	}
+	vTaskDelete(NULL);
+}
+
+esp_err_t system_file_init(system_file_t *system)
+{
+	esp_err_t e = Myware_spiffs_mount();
+	if (e != ESP_OK) {
+		return e;
+	}
+	system->sink.name = "file";
+	system->sink.level = CONFIG_SYSTEM_FILE_LOG_LEVEL;
+	e = system_log_sink_add(system->log, &system->sink);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "system_log_sink_add() failed with %d", e);
+		return e;
+	}
+	xTaskCreate((TaskFunction_t)private_task_my_file, "my_file", 1024 * 4, system, 4, NULL);
+	system->started_us = esp_timer_get_time();
+	return ESP_OK;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <sdkconfig.h>
+#include <esp_err.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include "systems/system_log.h"
+
+typedef struct {
+	system_log_t *log;
+	// Log lines appended to a file on the storage partition by my_file
+	system_log_sink_t sink;
+	atomic_uint bytes_written;
+	atomic_uint rotations;
+	int64_t started_us;
+} system_file_t;
+
+// Mounts the storage partition and starts appending to CONFIG_SYSTEM_FILE_LOG_PATH
+esp_err_t system_file_init(system_file_t *system);
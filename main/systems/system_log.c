@@ -0,0 +1,694 @@
+#include "system_log.h"
+#include "myware/myware_log.h"
+
+#include <string.h>
+#include <sys/param.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+
+static uint32_t private_sinks_want(system_log_t *system, uint8_t level, const char *tag, bool trace, uint32_t *deferred)
+{
+	// *deferred gets the sinks that would be fine with a trace record, NULL when the caller has the text anyway
+	uint32_t sinks = 0;
+	if (deferred != NULL) {
+		*deferred = 0;
+	}
+	int len = atomic_load(&system->sinks_len);
+	for (int i = 0; i < len; i++) {
+		system_log_sink_t *sink = system->sinks[i];
+		if (sink == NULL || level > sink->level || (trace && sink->trace == false)) {
+			continue;
+		}
+		system_log_want_t want = (sink->wants != NULL) ? sink->wants(sink->context, level, tag) : SYSTEM_LOG_WANT_TEXT;
+		if (want == SYSTEM_LOG_WANT_NONE) {
+			continue;
+		}
+		sinks |= 1u << i;
+		if (want == SYSTEM_LOG_WANT_TRACE && sink->trace && deferred != NULL) {
+			*deferred |= 1u << i;
+		}
+	}
+	return sinks;
+}
+
+static bool private_is_reader(system_log_t *system)
+{
+	TaskHandle_t task = xTaskGetCurrentTaskHandle();
+	int len = atomic_load(&system->ring.readers_len);
+	for (int i = 0; i < len; i++) {
+		if (system->ring.readers[i].task == task) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void private_dropped(system_log_t *system, uint32_t sinks, size_t size)
+{
+	// Bytes are the record's text and tag, the same for every sink it was for
+	int sinks_len = atomic_load(&system->sinks_len);
+	for (int i = 0; i < sinks_len; i++) {
+		if (sinks & (1u << i)) {
+			atomic_fetch_add(&system->sinks[i]->records_dropped, 1);
+			atomic_fetch_add(&system->sinks[i]->bytes_dropped, size - sizeof(system_log_record_t));
+		}
+	}
+}
+
+static system_log_record_t *private_reserve(system_log_t *system, uint32_t sinks, size_t size)
+{
+	while (1) {
+		system_log_record_t *record = Myware_ring_reserve(&system->ring, size);
+		if (record != NULL) {
+			record->sinks = sinks;
+			record->enqueued_us = (uint32_t)esp_timer_get_time();
+			return record;
+		}
+		bool block = false;
+		for (int i = 0; i < SYSTEM_LOG_SINKS_MAX; i++) {
+			if (sinks & (1u << i)) {
+				block |= system->sinks[i]->block;
+			}
+		}
+		// A sink's worker cannot wait for itself, and nothing can wait before the scheduler runs
+		if (block && xTaskGetSchedulerState() == taskSCHEDULER_RUNNING && private_is_reader(system) == false) {
+			vTaskDelay(1);
+			continue;
+		}
+		private_dropped(system, sinks, size);
+		return NULL;
+	}
+}
+
+static size_t private_tag_size(const char *tag)
+{
+	// Records keep a bounded copy of the tag behind the text, the logger's string may be gone before a sink reads it
+	return (tag == NULL) ? 0 : strnlen(tag, SYSTEM_LOG_TAG_LEN - 1) + 1;
+}
+
+static void private_tag_set(system_log_record_t *record, const char *tag, size_t text_size, size_t tag_size)
+{
+	record->tag_key = tag;
+	if (tag == NULL) {
+		record->tag = NULL;
+		return;
+	}
+	char *copy = record->text + text_size;
+	memcpy(copy, tag, tag_size - 1);
+	copy[tag_size - 1] = '\0';
+	record->tag = copy;
+}
+
+static bool private_vprintf_trace(system_log_t *system, uint32_t sinks, myware_log_meta_t *meta, va_list *args)
+{
+	// False when the payload can never fit the ring, the caller sends the line as text instead
+	va_list args_measure;
+	va_copy(args_measure, *args);
+	size_t len = Myware_log_trace(NULL, 0, meta->body_fmt, &args_measure);
+	va_end(args_measure);
+	size_t tag_size = private_tag_size(meta->tag);
+	size_t size = sizeof(system_log_record_t) + len + tag_size;
+	if (size > Myware_ring_max_size(&system->ring)) {
+		return false;
+	}
+	system_log_record_t *record = private_reserve(system, sinks, size);
+	if (record == NULL) {
+		return true;
+	}
+	Myware_log_trace((uint8_t *)record->text, len, meta->body_fmt, args);
+	record->trace = true;
+	record->fmt = meta->body_fmt;
+	record->level = meta->level;
+	record->timestamp = meta->timestamp;
+	private_tag_set(record, meta->tag, len, tag_size);
+	record->text_len = len;
+	record->body = 0;
+	record->body_len = len;
+	Myware_ring_commit(&system->ring, record);
+	return true;
+}
+
+static int private_vprintf_text(system_log_t *system, uint32_t sinks, const char *fmt, va_list args, myware_log_meta_t *meta)
+{
+	// Measure first so the line can be formatted straight into the record
+	va_list args_measure;
+	va_copy(args_measure, args);
+	int n = vsnprintf(NULL, 0, fmt, args_measure);
+	va_end(args_measure);
+	if (n < 0) {
+		return n;
+	}
+
+	// Records carry the NUL written by vsnprintf, oversized lines are cut for every sink
+	size_t tag_size = private_tag_size((meta != NULL) ? meta->tag : NULL);
+	size_t size = MIN(sizeof(system_log_record_t) + (size_t)n + 1 + tag_size, Myware_ring_max_size(&system->ring));
+	bool truncated = size < sizeof(system_log_record_t) + (size_t)n + 1 + tag_size;
+	system_log_record_t *record = private_reserve(system, sinks, size);
+	if (record == NULL) {
+		return n;
+	}
+	size_t text_size = size - sizeof(system_log_record_t) - tag_size;
+	vsnprintf(record->text, text_size, fmt, args);
+	record->trace = false;
+	record->fmt = NULL;
+	record->text_len = text_size - 1;
+	if (meta != NULL) {
+		size_t end = truncated ? record->text_len : record->text_len - meta->suffix_len;
+		record->level = meta->level;
+		record->timestamp = meta->timestamp;
+		private_tag_set(record, meta->tag, text_size, tag_size);
+		record->body = MIN(meta->prefix_len, record->text_len);
+		record->body_len = (end > record->body) ? (end - record->body) : 0;
+	} else {
+		record->level = ESP_LOG_NONE;
+		record->timestamp = esp_log_timestamp();
+		private_tag_set(record, NULL, text_size, tag_size);
+		record->body = 0;
+		record->body_len = record->text_len;
+	}
+	Myware_ring_commit(&system->ring, record);
+	return n;
+}
+
+static void private_line(system_log_t *system, uint32_t sinks, uint8_t level, uint32_t timestamp, const char *tag, const char *text, BaseType_t *woken)
+{
+	// No locks and no vsnprintf, the line is built by hand as "L (ms) tag: text\n"
+	static const char letters[] = "NEWIDV";
+	char digits[10];
+	size_t digits_len = 0;
+	uint32_t value = timestamp;
+	do {
+		digits[digits_len++] = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+	size_t tag_size = private_tag_size(tag);
+	size_t tag_len = tag_size - 1;
+	size_t prefix_len = 3 + digits_len + 2 + tag_len + 2;
+	size_t text_max = Myware_ring_max_size(&system->ring) - sizeof(system_log_record_t) - prefix_len - 2 - tag_size;
+	size_t text_len = MIN(strlen(text), text_max);
+	size_t len = prefix_len + text_len + 1;
+	system_log_record_t *record = Myware_ring_reserve(&system->ring, sizeof(system_log_record_t) + len + 1 + tag_size);
+	if (record == NULL) {
+		private_dropped(system, sinks, sizeof(system_log_record_t) + len + 1 + tag_size);
+		return;
+	}
+	char *p = record->text;
+	*p++ = letters[MIN(level, sizeof(letters) - 2)];
+	*p++ = ' ';
+	*p++ = '(';
+	while (digits_len > 0) {
+		*p++ = digits[--digits_len];
+	}
+	*p++ = ')';
+	*p++ = ' ';
+	memcpy(p, tag, tag_len);
+	p += tag_len;
+	*p++ = ':';
+	*p++ = ' ';
+	memcpy(p, text, text_len);
+	p += text_len;
+	*p++ = '\n';
+	*p = '\0';
+	record->sinks = sinks;
+	record->trace = false;
+	record->fmt = NULL;
+	record->level = level;
+	record->timestamp = timestamp;
+	private_tag_set(record, tag, len + 1, tag_size);
+	record->text_len = len;
+	record->body = prefix_len;
+	record->body_len = text_len;
+	if (woken != NULL) {
+		Myware_ring_commit_isr(&system->ring, record, woken);
+	} else {
+		Myware_ring_commit(&system->ring, record);
+	}
+}
+
+static uint32_t private_fingerprint(const char *body_fmt, va_list *args)
+{
+	// The format address and every argument identify a message without formatting it
+	va_list args_copy;
+	va_copy(args_copy, *args);
+	uint32_t hash = Myware_log_fingerprint(body_fmt, &args_copy);
+	va_end(args_copy);
+	return hash;
+}
+
+static system_log_tag_t *private_tag_scan(system_log_t *system, const char *tag, int len, bool key)
+{
+	// ESP_LOGx tags are static strings so the pointer matches first, names never change once published
+	for (int i = 0; i < len; i++) {
+		// A freed tag's address can be reused by another tag, the pointer is only a key
+		if (atomic_load_explicit(&system->tags[i].tag, memory_order_relaxed) == tag && strncmp(system->tags[i].name, tag, sizeof(system->tags[i].name) - 1) == 0) {
+			return &system->tags[i];
+		}
+	}
+	for (int i = 0; i < len; i++) {
+		system_log_tag_t *entry = &system->tags[i];
+		if (strncmp(entry->name, tag, sizeof(entry->name) - 1) == 0) {
+			if (key) {
+				// Later lookups of the same string take the pointer compare
+				const char *expected = NULL;
+				atomic_compare_exchange_strong(&entry->tag, &expected, tag);
+			}
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static system_log_tag_t *private_tag_find(system_log_t *system, const char *tag, bool add, bool key)
+{
+	// The table only grows and an entry is complete before tags_len covers it, lookups take no lock.
+	// key is false for strings that do not outlive the call, they are only matched by name.
+	int len = atomic_load_explicit(&system->tags_len, memory_order_acquire);
+	system_log_tag_t *entry = private_tag_scan(system, tag, len, key);
+	if (entry != NULL || add == false) {
+		return entry;
+	}
+	taskENTER_CRITICAL(&system->limits_lock);
+	len = atomic_load_explicit(&system->tags_len, memory_order_relaxed);
+	entry = private_tag_scan(system, tag, len, key);
+	if (entry == NULL && len < CONFIG_SYSTEM_LOG_TAGS_MAX) {
+		entry = &system->tags[len];
+		memset(entry, 0, sizeof(system_log_tag_t));
+		portMUX_INITIALIZE(&entry->lock);
+		atomic_store_explicit(&entry->tag, key ? tag : NULL, memory_order_relaxed);
+		strlcpy(entry->name, tag, sizeof(entry->name));
+		entry->rate = system->rate;
+		entry->burst = system->burst;
+		entry->tokens = system->burst * 1000;
+		entry->refill_ms = esp_log_timestamp();
+		atomic_store_explicit(&system->tags_len, len + 1, memory_order_release);
+	}
+	taskEXIT_CRITICAL(&system->limits_lock);
+	return entry;
+}
+
+static bool private_limit(system_log_t *system, myware_log_meta_t *meta, uint32_t hash, uint32_t *repeats, uint8_t *repeats_level, uint32_t *rate_dropped)
+{
+	bool pass = true;
+	*repeats = 0;
+	*rate_dropped = 0;
+	system_log_tag_t *entry = private_tag_find(system, meta->tag, true, true);
+	if (entry == NULL) {
+		// Tag table is full, the tag is not limited
+		return true;
+	}
+	// Only this tag's state is locked, and only for the update
+	taskENTER_CRITICAL(&entry->lock);
+	if (entry->repeats_hash == hash && entry->repeats_level == meta->level && entry->repeats_valid && (meta->timestamp - entry->repeats_last_ms) < CONFIG_SYSTEM_LOG_REPEAT_WINDOW_MS) {
+		entry->repeats_last_ms = meta->timestamp;
+		entry->repeats++;
+		entry->suppressed_repeats++;
+		pass = false;
+		// A long storm is reported once a second instead of only when it ends
+		if ((meta->timestamp - entry->repeats_ms) >= 1000) {
+			*repeats = entry->repeats;
+			*repeats_level = entry->repeats_level;
+			entry->repeats = 0;
+			entry->repeats_ms = meta->timestamp;
+		}
+	} else {
+		*repeats = entry->repeats;
+		*repeats_level = entry->repeats_level;
+		entry->repeats = 0;
+		entry->repeats_hash = hash;
+		entry->repeats_level = meta->level;
+		entry->repeats_valid = true;
+		entry->repeats_ms = meta->timestamp;
+		entry->repeats_last_ms = meta->timestamp;
+		// Errors and warnings are only limited by a rate the tag was given itself
+		if (entry->rate > 0 && (entry->custom || meta->level > ESP_LOG_WARN)) {
+			// Tokens are kept in thousandths, rate is lines per second so one ms refills rate thousandths
+			uint64_t tokens = entry->tokens + (uint64_t)(meta->timestamp - entry->refill_ms) * entry->rate;
+			entry->tokens = MIN(tokens, (uint64_t)entry->burst * 1000);
+			entry->refill_ms = meta->timestamp;
+			if (entry->tokens >= 1000) {
+				entry->tokens -= 1000;
+				*rate_dropped = entry->rate_dropped;
+				entry->rate_dropped = 0;
+			} else {
+				entry->rate_dropped++;
+				entry->suppressed_rate++;
+				pass = false;
+			}
+		}
+	}
+	taskEXIT_CRITICAL(&entry->lock);
+	return pass;
+}
+
+static void private_notice(system_log_t *system, uint8_t level, uint32_t timestamp, const char *tag, const char *fmt, uint32_t count)
+{
+	uint32_t sinks = private_sinks_want(system, level, tag, false, NULL);
+	if (sinks == 0) {
+		return;
+	}
+	char text[48];
+	snprintf(text, sizeof(text), fmt, (unsigned)count);
+	private_line(system, sinks, level, timestamp, tag, text, NULL);
+}
+
+static void private_repeats_flush(system_log_t *system)
+{
+	// Runs periodically, a tag that went quiet still reports how often its last message was dropped
+	uint32_t now = esp_log_timestamp();
+	int len = atomic_load_explicit(&system->tags_len, memory_order_acquire);
+	for (int i = 0; i < len; i++) {
+		uint32_t repeats = 0;
+		uint8_t level = 0;
+		system_log_tag_t *entry = &system->tags[i];
+		taskENTER_CRITICAL(&entry->lock);
+		if (entry->repeats > 0 && (now - entry->repeats_last_ms) >= CONFIG_SYSTEM_LOG_REPEAT_WINDOW_MS) {
+			repeats = entry->repeats;
+			level = entry->repeats_level;
+			entry->repeats = 0;
+		}
+		taskEXIT_CRITICAL(&entry->lock);
+		if (repeats > 0) {
+			private_notice(system, level, now, entry->name, "last message repeated %u times", repeats);
+		}
+	}
+}
+
+int system_log_vprintf(system_log_t *system, const char *fmt, va_list args)
+{
+	if (system->ring.buf == NULL) {
+		return vprintf(fmt, args);
+	}
+
+	myware_log_meta_t meta;
+	va_list args_body;
+	va_copy(args_body, args);
+	bool is_log = Myware_log_parse(fmt, &args_body, &meta);
+	if (is_log) {
+		// Repeats and lines over the tag's rate are dropped before anything is formatted
+		uint32_t repeats;
+		uint8_t repeats_level;
+		uint32_t rate_dropped;
+		bool pass = private_limit(system, &meta, private_fingerprint(meta.body_fmt, &args_body), &repeats, &repeats_level, &rate_dropped);
+		if (repeats > 0) {
+			private_notice(system, repeats_level, meta.timestamp, meta.tag, "last message repeated %u times", repeats);
+		}
+		if (rate_dropped > 0) {
+			private_notice(system, ESP_LOG_WARN, meta.timestamp, meta.tag, "%u lines suppressed by rate limit", rate_dropped);
+		}
+		if (pass == false) {
+			va_end(args_body);
+			return 0;
+		}
+	}
+	uint8_t level = is_log ? meta.level : ESP_LOG_NONE;
+	const char *tag = is_log ? meta.tag : NULL;
+	// Deferred formatting, the host formats the line from the ELF and text only sinks do not get it
+	bool trace = is_log && Myware_log_get_trace() && meta.level > CONFIG_MYWARE_LOG_TRACE_UART_LEVEL;
+	uint32_t deferred;
+	uint32_t sinks = private_sinks_want(system, level, tag, trace, &deferred);
+	if (is_log && sinks != 0 && sinks == deferred) {
+		// Only kept for later, the line is formatted from the trace record if it is ever read
+		trace = true;
+	}
+	int n = 0;
+	if (sinks == 0) {
+		// Nobody wants the line, it is not formatted at all
+	} else if (trace && private_vprintf_trace(system, sinks, &meta, &args_body)) {
+		// Formatted on the host or when a sink reads it
+	} else {
+		// An oversized trace record is cut like any long line instead of being lost
+		n = private_vprintf_text(system, sinks, fmt, args, is_log ? &meta : NULL);
+	}
+	va_end(args_body);
+	return n;
+}
+
+void system_log_isr(system_log_t *system, uint8_t level, const char *tag, const char *text, BaseType_t *woken)
+{
+	if (system->ring.buf == NULL) {
+		return;
+	}
+	uint32_t sinks = 0;
+	int sinks_len = atomic_load(&system->sinks_len);
+	for (int i = 0; i < sinks_len; i++) {
+		if (system->sinks[i] != NULL && level <= system->sinks[i]->level) {
+			sinks |= 1u << i;
+		}
+	}
+	if (sinks == 0) {
+		return;
+	}
+	private_line(system, sinks, level, xTaskGetTickCountFromISR() * portTICK_PERIOD_MS, tag, text, woken);
+}
+
+static bool private_sink_skips(const void *data, size_t len, void *context)
+{
+	// Only records the sink wanted count as dropped when the ring skips past them
+	const system_log_record_t *record = data;
+	system_log_sink_t *sink = context;
+	return record->sinks & (1u << sink->id);
+}
+
+esp_err_t system_log_sink_add(system_log_t *system, system_log_sink_t *sink)
+{
+	esp_err_t e = ESP_OK;
+	xSemaphoreTake(system->sinks_lock, portMAX_DELAY);
+	int id = Myware_ring_reader_add(&system->ring);
+	if (id < 0) {
+		ESP_LOGE(__func__, "no room for sink %s", sink->name);
+		e = ESP_ERR_NO_MEM;
+	} else {
+		sink->id = id;
+		atomic_store(&sink->records, 0);
+		atomic_store(&sink->records_dropped, 0);
+		atomic_store(&sink->bytes_dropped, 0);
+		Myware_ring_reader_set_filter(&system->ring, id, private_sink_skips, sink);
+		Myware_ring_reader_set_lossy(&system->ring, id, !sink->block);
+		system->sinks[id] = sink;
+		// Loggers only look at sinks below sinks_len
+		atomic_store(&system->sinks_len, MAX(atomic_load(&system->sinks_len), id + 1));
+	}
+	xSemaphoreGive(system->sinks_lock);
+	return e;
+}
+
+void system_log_sink_set_block(system_log_t *system, system_log_sink_t *sink, bool block)
+{
+	sink->block = block;
+	Myware_ring_reader_set_lossy(&system->ring, sink->id, !block);
+}
+
+system_log_sink_t *system_log_sink_find(system_log_t *system, const char *name)
+{
+	int len = atomic_load(&system->sinks_len);
+	for (int i = 0; i < len; i++) {
+		if (system->sinks[i] != NULL && strcmp(system->sinks[i]->name, name) == 0) {
+			return system->sinks[i];
+		}
+	}
+	return NULL;
+}
+
+system_log_record_t *system_log_receive(system_log_t *system, system_log_sink_t *sink, TickType_t timeout)
+{
+	TickType_t start = xTaskGetTickCount();
+	while (1) {
+		TickType_t elapsed = xTaskGetTickCount() - start;
+		if (elapsed > timeout) {
+			return NULL;
+		}
+		size_t len;
+		system_log_record_t *record = Myware_ring_receive(&system->ring, sink->id, &len, timeout - elapsed);
+		// A drop sink that fell behind was moved past records by loggers that needed the space
+		uint32_t skipped_bytes;
+		uint32_t skipped = Myware_ring_reader_skipped(&system->ring, sink->id, &skipped_bytes);
+		if (skipped) {
+			atomic_fetch_add(&sink->records_dropped, skipped);
+			atomic_fetch_add(&sink->bytes_dropped, skipped_bytes - skipped * sizeof(system_log_record_t));
+		}
+		if (record == NULL) {
+			return NULL;
+		}
+		if (record->sinks & (1u << sink->id)) {
+			atomic_fetch_add(&sink->records, 1);
+			return record;
+		}
+		// Another sink's record, skipped without looking at it
+		Myware_ring_release(&system->ring, sink->id, record);
+	}
+}
+
+void system_log_release(system_log_t *system, system_log_sink_t *sink, system_log_record_t *record)
+{
+	// Sinks release a record once they have written it out
+	Myware_hist_record(&sink->latency, (uint32_t)esp_timer_get_time() - record->enqueued_us);
+	Myware_ring_release(&system->ring, sink->id, record);
+}
+
+esp_err_t system_log_init(system_log_t *system)
+{
+	portMUX_INITIALIZE(&system->limits_lock);
+	system->rate = CONFIG_SYSTEM_LOG_RATE;
+	system->burst = CONFIG_SYSTEM_LOG_BURST;
+	system->sinks_lock = xSemaphoreCreateMutex();
+	if (system->sinks_lock == NULL) {
+		ESP_LOGE(__func__, "xSemaphoreCreateMutex() failed");
+		return ESP_FAIL;
+	}
+	esp_err_t e = Myware_ring_init(&system->ring, CONFIG_SYSTEM_LOG_BUF_SIZE);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "Myware_ring_init() failed with %d", e);
+		return e;
+	}
+	const esp_timer_create_args_t repeats_args = {
+	.callback = (esp_timer_cb_t)private_repeats_flush,
+	.arg = system,
+	.name = "log_repeats"};
+	e = esp_timer_create(&repeats_args, &system->repeats_timer);
+	if (e == ESP_OK) {
+		e = esp_timer_start_periodic(system->repeats_timer, CONFIG_SYSTEM_LOG_REPEAT_WINDOW_MS * 1000);
+	}
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "repeats timer failed with %d", e);
+		return e;
+	}
+	system->started_us = esp_timer_get_time();
+	return ESP_OK;
+}
+
+void system_log_print_sinks(system_log_t *system, FILE *f)
+{
+	if (system->ring.buf == NULL) {
+		fprintf(f, "log router is not running\n");
+		return;
+	}
+	fprintf(f, "ring: %u/%u bytes used\n", (unsigned)Myware_ring_used(&system->ring), (unsigned)system->ring.size);
+	fprintf(f, "%-8s %-8s %-6s %-6s %10s %10s %13s\n", "sink", "level", "trace", "full", "records", "dropped", "bytes dropped");
+	int len = atomic_load(&system->sinks_len);
+	for (int i = 0; i < len; i++) {
+		system_log_sink_t *sink = system->sinks[i];
+		if (sink == NULL) {
+			continue;
+		}
+		fprintf(f, "%-8s %-8s %-6s %-6s %10u %10u %13u\n", sink->name, Myware_log_level_str(sink->level), sink->trace ? "yes" : "no", sink->block ? "block" : "drop", atomic_load(&sink->records), atomic_load(&sink->records_dropped), atomic_load(&sink->bytes_dropped));
+	}
+}
+
+void system_log_print_latency(system_log_t *system, FILE *f)
+{
+	fprintf(f, "%-8s %10s %10s %10s %10s\n", "sink", "records", "p50 us", "p99 us", "max us");
+	int len = atomic_load(&system->sinks_len);
+	for (int i = 0; i < len; i++) {
+		system_log_sink_t *sink = system->sinks[i];
+		if (sink == NULL) {
+			continue;
+		}
+		myware_hist_t *hist = &sink->latency;
+		fprintf(f, "%-8s %10u %10u %10u %10u\n", sink->name, (unsigned)Myware_hist_count(hist), (unsigned)Myware_hist_percentile(hist, 500), (unsigned)Myware_hist_percentile(hist, 990), (unsigned)hist->max);
+	}
+}
+
+void system_log_reset_latency(system_log_t *system)
+{
+	int len = atomic_load(&system->sinks_len);
+	for (int i = 0; i < len; i++) {
+		if (system->sinks[i] != NULL) {
+			Myware_hist_reset(&system->sinks[i]->latency);
+		}
+	}
+}
+
+esp_err_t system_log_set_rate(system_log_t *system, const char *tag, uint32_t rate, uint32_t burst)
+{
+	if (strcmp(tag, "*") == 0) {
+		// Tags added meanwhile take the new default from the lock
+		taskENTER_CRITICAL(&system->limits_lock);
+		system->rate = rate;
+		system->burst = burst;
+		int len = atomic_load_explicit(&system->tags_len, memory_order_relaxed);
+		for (int i = 0; i < len; i++) {
+			system_log_tag_t *entry = &system->tags[i];
+			taskENTER_CRITICAL(&entry->lock);
+			if (entry->custom == false) {
+				entry->rate = rate;
+				entry->burst = burst;
+			}
+			taskEXIT_CRITICAL(&entry->lock);
+		}
+		taskEXIT_CRITICAL(&system->limits_lock);
+		return ESP_OK;
+	}
+	// The console's string does not outlive the command, the entry is matched by name until the tag logs
+	system_log_tag_t *entry = private_tag_find(system, tag, true, false);
+	if (entry == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	taskENTER_CRITICAL(&entry->lock);
+	entry->rate = rate;
+	entry->burst = burst;
+	entry->tokens = burst * 1000;
+	entry->custom = true;
+	taskEXIT_CRITICAL(&entry->lock);
+	return ESP_OK;
+}
+
+bool system_log_get_rate(system_log_t *system, const char *tag, uint32_t *rate, uint32_t *burst)
+{
+	system_log_tag_t *entry = private_tag_find(system, tag, false, false);
+	bool custom = false;
+	if (entry != NULL) {
+		taskENTER_CRITICAL(&entry->lock);
+		custom = entry->custom;
+		*rate = entry->rate;
+		*burst = entry->burst;
+		taskEXIT_CRITICAL(&entry->lock);
+	}
+	if (custom == false) {
+		taskENTER_CRITICAL(&system->limits_lock);
+		*rate = system->rate;
+		*burst = system->burst;
+		taskEXIT_CRITICAL(&system->limits_lock);
+	}
+	return custom;
+}
+
+void system_log_reset_rate(system_log_t *system, const char *tag)
+{
+	system_log_tag_t *entry = private_tag_find(system, tag, false, false);
+	if (entry == NULL) {
+		return;
+	}
+	// Same lock order as setting "*", so the default cannot change in between
+	taskENTER_CRITICAL(&system->limits_lock);
+	taskENTER_CRITICAL(&entry->lock);
+	entry->rate = system->rate;
+	entry->burst = system->burst;
+	entry->tokens = system->burst * 1000;
+	entry->custom = false;
+	taskEXIT_CRITICAL(&entry->lock);
+	taskEXIT_CRITICAL(&system->limits_lock);
+}
+
+void system_log_print_rates(system_log_t *system, FILE *f)
+{
+	// One entry is copied under its lock at a time, printing can log
+	taskENTER_CRITICAL(&system->limits_lock);
+	uint32_t rate = system->rate;
+	uint32_t burst = system->burst;
+	taskEXIT_CRITICAL(&system->limits_lock);
+	fprintf(f, "%-16s %6s %6s %10s %10s\n", "tag", "rate", "burst", "repeats", "limited");
+	fprintf(f, "%-16s %6u %6u\n", "*", (unsigned)rate, (unsigned)burst);
+	int len = atomic_load_explicit(&system->tags_len, memory_order_acquire);
+	for (int i = 0; i < len; i++) {
+		system_log_tag_t *entry = &system->tags[i];
+		taskENTER_CRITICAL(&entry->lock);
+		rate = entry->rate;
+		burst = entry->burst;
+		uint32_t suppressed_repeats = entry->suppressed_repeats;
+		uint32_t suppressed_rate = entry->suppressed_rate;
+		taskEXIT_CRITICAL(&entry->lock);
+		// name never changes once the entry is published
+		fprintf(f, "%-16s %6u %6u %10u %10u\n", entry->name, (unsigned)rate, (unsigned)burst, (unsigned)suppressed_repeats, (unsigned)suppressed_rate);
+	}
+}
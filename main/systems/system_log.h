@@ -0,0 +1,152 @@
+#pragma once
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "myware/myware_ring.h"
+#include "myware/myware_hist.h"
+
+#define SYSTEM_LOG_SINKS_MAX MYWARE_RING_READERS_MAX
+// Longest tag kept, with the NUL. Longer tags are cut to it in records and in the rate table.
+#define SYSTEM_LOG_TAG_LEN 24
+
+// Answer of a sink's wants() for one line
+typedef enum {
+	SYSTEM_LOG_WANT_NONE,
+	// Only kept for later, a Myware_log_trace() record does until some sink needs the text
+	SYSTEM_LOG_WANT_TRACE,
+	SYSTEM_LOG_WANT_TEXT,
+} system_log_want_t;
+
+// Record in the shared log ring, formatted once and read in place by every sink it is for.
+// Valid from system_log_receive() until system_log_release(), a drop sink that falls behind loses records it has not received yet.
+typedef struct {
+	// Sinks the record is for, bit n is the sink with id n
+	uint32_t sinks;
+	uint32_t timestamp;
+	// Low 32 bits of esp_timer_get_time() when the record was reserved
+	uint32_t enqueued_us;
+	// Bounded copy of the tag behind the text, valid as long as the record. NULL for lines that are not ESP_LOGx output.
+	const char *tag;
+	// The logger's tag pointer, only a fast-path key for tables of tags, never read
+	const char *tag_key;
+	uint8_t level;
+	// text holds a Myware_log_trace() payload instead of a formatted line
+	bool trace;
+	// Body format of a trace record, for formatting it on the device. The payload's copy of the address is cut to 32 bits.
+	const char *fmt;
+	// Message body inside text, without the "I (123) tag: " prefix and color codes
+	uint16_t body;
+	uint16_t body_len;
+	uint16_t text_len;
+	char text[];
+} system_log_record_t;
+
+// A destination for log records with its own worker task
+typedef struct {
+	const char *name;
+	// Highest level the sink takes
+	uint8_t level;
+	// Takes Myware_log_trace() records, other sinks only get formatted text
+	bool trace;
+	// Logging waits for this sink when the ring is full, a drop sink is skipped ahead instead.
+	// Changed with system_log_sink_set_block() once the sink is added.
+	bool block;
+	// Optional finer check made before formatting, NULL takes every line up to level as text.
+	// SYSTEM_LOG_WANT_TRACE is only honoured for sinks that take trace records.
+	system_log_want_t (*wants)(void *context, uint8_t level, const char *tag);
+	void *context;
+	// Set by system_log_sink_add()
+	int id;
+	atomic_uint records;
+	atomic_uint records_dropped;
+	// Text and tag bytes of the dropped records
+	atomic_uint bytes_dropped;
+	// Microseconds from reserve to system_log_release(), recorded by the sink's task
+	myware_hist_t latency;
+} system_log_sink_t;
+
+// Repeat and rate state of one tag
+typedef struct {
+	// Held only to update the entry, never while looking it up
+	portMUX_TYPE lock;
+	// Pointer of the ESP_LOGx tag, a fast-path key only. NULL until the tag logs when it was added from the console.
+	_Atomic(const char *) tag;
+	// Set before the entry is published and never changed
+	char name[SYSTEM_LOG_TAG_LEN];
+	// Lines per second, 0 is unlimited, burst is the bucket size
+	uint32_t rate;
+	uint32_t burst;
+	// Set by the console, not changed by the "*" default
+	bool custom;
+	// Thousandths of a line
+	uint32_t tokens;
+	uint32_t refill_ms;
+	uint32_t rate_dropped;
+	// Last message and how many times it was dropped as a repeat since it was reported
+	bool repeats_valid;
+	uint32_t repeats_hash;
+	uint8_t repeats_level;
+	uint32_t repeats;
+	uint32_t repeats_ms;
+	// When the last message was last seen, only repeats within CONFIG_SYSTEM_LOG_REPEAT_WINDOW_MS are collapsed
+	uint32_t repeats_last_ms;
+	uint32_t suppressed_repeats;
+	uint32_t suppressed_rate;
+} system_log_tag_t;
+
+typedef struct {
+	// Every sink reads the same formatted records at its own position
+	myware_ring_t ring;
+	SemaphoreHandle_t sinks_lock;
+	system_log_sink_t *sinks[SYSTEM_LOG_SINKS_MAX];
+	atomic_int sinks_len;
+	// Per tag repeat suppression and token buckets, checked before formatting.
+	// limits_lock only serialises adding tags and changing the default, tags_len is published with release.
+	portMUX_TYPE limits_lock;
+	system_log_tag_t tags[CONFIG_SYSTEM_LOG_TAGS_MAX];
+	atomic_int tags_len;
+	// Rate and burst of tags without their own
+	uint32_t rate;
+	uint32_t burst;
+	// Reports the repeats of tags that went quiet
+	esp_timer_handle_t repeats_timer;
+	// esp_timer_get_time() when init succeeded, 0 while not running
+	int64_t started_us;
+} system_log_t;
+
+esp_err_t system_log_init(system_log_t *system);
+
+// The sink gets records logged from now on, read them from one task only
+esp_err_t system_log_sink_add(system_log_t *system, system_log_sink_t *sink);
+system_log_sink_t *system_log_sink_find(system_log_t *system, const char *name);
+void system_log_sink_set_block(system_log_t *system, system_log_sink_t *sink, bool block);
+system_log_record_t *system_log_receive(system_log_t *system, system_log_sink_t *sink, TickType_t timeout);
+void system_log_release(system_log_t *system, system_log_sink_t *sink, system_log_record_t *record);
+
+// The esp_log_set_vprintf() hook: parses the ESP_LOGx line, picks the sinks and formats once for all of them
+int system_log_vprintf(system_log_t *system, const char *fmt, va_list args);
+
+// Logs text from an ISR, where ESP_LOGx is not allowed. Not inside a critical section or with interrupts disabled,
+// the commit notifies the sink tasks.
+// Sinks are picked by level only, the line is built without vsnprintf.
+void system_log_isr(system_log_t *system, uint8_t level, const char *tag, const char *text, BaseType_t *woken);
+
+void system_log_print_sinks(system_log_t *system, FILE *f);
+void system_log_print_latency(system_log_t *system, FILE *f);
+void system_log_reset_latency(system_log_t *system);
+
+// Token bucket for one tag, "*" sets the default of every tag without its own. rate 0 is unlimited.
+// The default only limits info and below, a tag's own rate also limits its errors and warnings.
+esp_err_t system_log_set_rate(system_log_t *system, const char *tag, uint32_t rate, uint32_t burst);
+// Rate and burst the tag is limited by, false when it has none of its own and follows "*"
+bool system_log_get_rate(system_log_t *system, const char *tag, uint32_t *rate, uint32_t *burst);
+// Drops the tag's own rate, it follows "*" again
+void system_log_reset_rate(system_log_t *system, const char *tag);
+void system_log_print_rates(system_log_t *system, FILE *f);
@@ -0,0 +1,262 @@
+#include "system_metrics.h"
+#include "hardware/hardware_wifi.h"
+#include "myware/myware_heapstat.h"
+
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#if !CONFIG_IDF_TARGET_LINUX
+#include <esp_heap_caps.h>
+#endif
+#include <esp_http_server.h>
+#include <freertos/task.h>
+
+// Lines are collected here and sent as one HTTP chunk when it is full
+#define SYSTEM_METRICS_CHUNK_SIZE 512
+
+typedef struct {
+	httpd_req_t *req;
+	// First send error, nothing is sent after it
+	esp_err_t e;
+	size_t len;
+	char buf[SYSTEM_METRICS_CHUNK_SIZE];
+} private_writer_t;
+
+static void private_flush(private_writer_t *w)
+{
+	if (w->e == ESP_OK && w->len > 0) {
+		w->e = httpd_resp_send_chunk(w->req, w->buf, w->len);
+	}
+	w->len = 0;
+}
+
+// Appends one line, a line longer than the chunk is cut
+static void __attribute__((format(printf, 2, 3))) private_printf(private_writer_t *w, const char *fmt, ...)
+{
+	for (int attempt = 0; attempt < 2; attempt++) {
+		va_list args;
+		va_start(args, fmt);
+		int n = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, args);
+		va_end(args);
+		if (n < 0) {
+			return;
+		}
+		if ((w->len + n) < sizeof(w->buf)) {
+			w->len += n;
+			return;
+		}
+		if (w->len == 0) {
+			w->len = sizeof(w->buf) - 1;
+			w->buf[w->len - 1] = '\n';
+			return;
+		}
+		private_flush(w);
+	}
+}
+
+static void private_family(private_writer_t *w, const char *name, const char *type, const char *help)
+{
+	private_printf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void private_heap(private_writer_t *w)
+{
+#if !CONFIG_IDF_TARGET_LINUX
+	private_family(w, "esp_heap_free_bytes", "gauge", "Free heap");
+	private_printf(w, "esp_heap_free_bytes %u\n", (unsigned)esp_get_free_heap_size());
+	private_family(w, "esp_heap_min_free_bytes", "gauge", "Lowest free heap since boot");
+	private_printf(w, "esp_heap_min_free_bytes %u\n", (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT));
+	private_family(w, "esp_heap_largest_free_block_bytes", "gauge", "Largest block malloc() can return");
+	private_printf(w, "esp_heap_largest_free_block_bytes %u\n", (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+	uint32_t frag = Myware_heapstat_fragmentation(MALLOC_CAP_DEFAULT);
+	private_family(w, "esp_heap_fragmentation_ratio", "gauge", "1 - largest free block / free heap");
+	private_printf(w, "esp_heap_fragmentation_ratio %u.%03u\n", (unsigned)(frag / 1000), (unsigned)(frag % 1000));
+#endif
+	myware_heapstat_counts_t counts;
+	if (Myware_heapstat_counts(&counts) == ESP_OK) {
+		private_family(w, "esp_heap_allocs_total", "counter", "Allocations since boot");
+		private_printf(w, "esp_heap_allocs_total %u\n", (unsigned)counts.allocs);
+		private_family(w, "esp_heap_frees_total", "counter", "Frees since boot");
+		private_printf(w, "esp_heap_frees_total %u\n", (unsigned)counts.frees);
+		private_family(w, "esp_heap_allocated_bytes_total", "counter", "Bytes allocated since boot");
+		private_printf(w, "esp_heap_allocated_bytes_total %" PRIu64 "\n", counts.bytes_allocated);
+	}
+}
+
+static void private_tasks(private_writer_t *w)
+{
+	// Room for tasks created between the count and the snapshot
+	UBaseType_t len = uxTaskGetNumberOfTasks() + 2;
+	TaskStatus_t *tasks = malloc(len * sizeof(TaskStatus_t));
+	if (tasks == NULL) {
+		ESP_LOGE(__func__, "malloc() failed");
+		return;
+	}
+	len = uxTaskGetSystemState(tasks, len, NULL);
+	private_family(w, "esp_tasks", "gauge", "Number of tasks");
+	private_printf(w, "esp_tasks %u\n", (unsigned)len);
+	private_family(w, "esp_task_stack_free_min_bytes", "gauge", "Stack high-water mark, the least free stack the task has had");
+	for (UBaseType_t i = 0; i < len; i++) {
+		private_printf(w, "esp_task_stack_free_min_bytes{task=\"%s\"} %u\n", tasks[i].pcTaskName, (unsigned)tasks[i].usStackHighWaterMark);
+	}
+	free(tasks);
+}
+
+static void private_log(private_writer_t *w, system_log_t *log)
+{
+	if (log == NULL || log->ring.buf == NULL) {
+		return;
+	}
+	private_family(w, "esp_log_ring_used_bytes", "gauge", "Bytes of the log ring not yet released by every sink");
+	private_printf(w, "esp_log_ring_used_bytes %u\n", (unsigned)Myware_ring_used(&log->ring));
+	private_family(w, "esp_log_ring_size_bytes", "gauge", "Size of the log ring");
+	private_printf(w, "esp_log_ring_size_bytes %u\n", (unsigned)log->ring.size);
+	private_family(w, "esp_log_ring_dropped_total", "counter", "Log records that did not fit in the ring");
+	private_printf(w, "esp_log_ring_dropped_total %u\n", atomic_load(&log->ring.dropped));
+
+	int len = atomic_load(&log->sinks_len);
+	private_family(w, "esp_log_sink_records_total", "counter", "Log records read by the sink");
+	for (int i = 0; i < len; i++) {
+		system_log_sink_t *sink = log->sinks[i];
+		if (sink != NULL) {
+			private_printf(w, "esp_log_sink_records_total{sink=\"%s\"} %u\n", sink->name, atomic_load(&sink->records));
+		}
+	}
+	private_family(w, "esp_log_sink_dropped_total", "counter", "Log records the sink missed because the ring was full");
+	for (int i = 0; i < len; i++) {
+		system_log_sink_t *sink = log->sinks[i];
+		if (sink != NULL) {
+			private_printf(w, "esp_log_sink_dropped_total{sink=\"%s\"} %u\n", sink->name, atomic_load(&sink->records_dropped));
+		}
+	}
+	private_family(w, "esp_log_sink_dropped_bytes_total", "counter", "Text bytes of the log records the sink missed");
+	for (int i = 0; i < len; i++) {
+		system_log_sink_t *sink = log->sinks[i];
+		if (sink != NULL) {
+			private_printf(w, "esp_log_sink_dropped_bytes_total{sink=\"%s\"} %u\n", sink->name, atomic_load(&sink->bytes_dropped));
+		}
+	}
+}
+
+static void private_web(private_writer_t *w, system_web_t *web)
+{
+	if (web == NULL || web->clients_lock == NULL) {
+		return;
+	}
+	// Copied under the lock, which is never held while sending
+	bool active[CONFIG_SYSTEM_WEB_MAX_CLIENTS];
+	uint64_t sent[CONFIG_SYSTEM_WEB_MAX_CLIENTS];
+	uint64_t dropped[CONFIG_SYSTEM_WEB_MAX_CLIENTS];
+	unsigned pending[CONFIG_SYSTEM_WEB_MAX_CLIENTS];
+	unsigned clients = 0;
+	xSemaphoreTake(web->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &web->clients[i];
+		active[i] = client->active;
+		if (client->active == false) {
+			continue;
+		}
+		clients++;
+		sent[i] = client->bytes_sent;
+		dropped[i] = client->bytes_dropped;
+		pending[i] = uxQueueMessagesWaiting(client->queue);
+	}
+	xSemaphoreGive(web->clients_lock);
+
+	private_family(w, "esp_web_clients", "gauge", "Connected WebSocket clients");
+	private_printf(w, "esp_web_clients %u\n", clients);
+	private_family(w, "esp_web_client_sent_bytes_total", "counter", "Bytes sent to the client since it connected");
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		if (active[i]) {
+			private_printf(w, "esp_web_client_sent_bytes_total{slot=\"%i\"} %" PRIu64 "\n", i, sent[i]);
+		}
+	}
+	private_family(w, "esp_web_client_dropped_bytes_total", "counter", "Bytes dropped by the send policy since the client connected");
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		if (active[i]) {
+			private_printf(w, "esp_web_client_dropped_bytes_total{slot=\"%i\"} %" PRIu64 "\n", i, dropped[i]);
+		}
+	}
+	private_family(w, "esp_web_client_pending_frames", "gauge", "Frames queued to the client");
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		if (active[i]) {
+			private_printf(w, "esp_web_client_pending_frames{slot=\"%i\"} %u\n", i, pending[i]);
+		}
+	}
+}
+
+static void private_uptime(private_writer_t *w, const char *name, int64_t started_us, int64_t now)
+{
+	if (started_us == 0) {
+		return;
+	}
+	int64_t us = now - started_us;
+	private_printf(w, "esp_system_uptime_seconds{system=\"%s\"} %" PRId64 ".%03" PRId64 "\n", name, us / 1000000, (us / 1000) % 1000);
+}
+
+static esp_err_t private_metrics_handler(httpd_req_t *req)
+{
+	system_metrics_t *system = req->user_ctx;
+	atomic_fetch_add(&system->scrapes, 1);
+	private_writer_t *w = calloc(1, sizeof(private_writer_t));
+	if (w == NULL) {
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "out of memory");
+		return ESP_FAIL;
+	}
+	w->req = req;
+	httpd_resp_set_type(req, "text/plain; version=0.0.4; charset=utf-8");
+
+	int64_t now = esp_timer_get_time();
+	private_family(w, "esp_uptime_seconds", "gauge", "Time since boot");
+	private_printf(w, "esp_uptime_seconds %" PRId64 ".%03" PRId64 "\n", now / 1000000, (now / 1000) % 1000);
+	private_family(w, "esp_system_uptime_seconds", "gauge", "Time since the system was started");
+	private_uptime(w, "log", system->log ? system->log->started_us : 0, now);
+	private_uptime(w, "uart", system->uart ? system->uart->started_us : 0, now);
+	private_uptime(w, "web", system->web ? system->web->started_us : 0, now);
+	private_uptime(w, "file", system->file ? system->file->started_us : 0, now);
+	private_uptime(w, "udp", system->udp ? system->udp->started_us : 0, now);
+	private_family(w, "esp_metrics_scrapes_total", "counter", "Requests to /metrics");
+	private_printf(w, "esp_metrics_scrapes_total %u\n", atomic_load(&system->scrapes));
+
+	private_heap(w);
+	private_tasks(w);
+	private_log(w, system->log);
+	private_web(w, system->web);
+
+	int rssi;
+	if (Hardware_wifi_get_rssi(&rssi) == ESP_OK) {
+		private_family(w, "esp_wifi_rssi_dbm", "gauge", "Signal strength of the access point");
+		private_printf(w, "esp_wifi_rssi_dbm %i\n", rssi);
+	}
+
+	private_flush(w);
+	esp_err_t e = w->e;
+	free(w);
+	if (e != ESP_OK) {
+		ESP_LOGW(__func__, "httpd_resp_send_chunk() failed with %d", e);
+		return e;
+	}
+	return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t system_metrics_init(system_metrics_t *system)
+{
+	if (system->web == NULL || system->web->server == NULL) {
+		ESP_LOGE(__func__, "web server is not running");
+		return ESP_ERR_INVALID_STATE;
+	}
+	httpd_uri_t uri_metrics = {
+	.uri = "/metrics",
+	.method = HTTP_GET,
+	.handler = private_metrics_handler,
+	.user_ctx = system};
+	esp_err_t e = httpd_register_uri_handler(system->web->server, &uri_metrics);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "httpd_register_uri_handler() failed with %d", e);
+		return e;
+	}
+	return ESP_OK;
+}
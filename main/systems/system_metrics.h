@@ -0,0 +1,22 @@
+#pragma once
+#include <sdkconfig.h>
+#include <esp_err.h>
+#include <stdatomic.h>
+#include "systems/system_log.h"
+#include "systems/system_web.h"
+#include "systems/system_uart.h"
+#include "systems/system_file.h"
+#include "systems/system_udp.h"
+
+// Read-only view of the other systems, served as Prometheus text on /metrics
+typedef struct {
+	system_log_t *log;
+	system_web_t *web;
+	system_uart_t *uart;
+	system_file_t *file;
+	system_udp_t *udp;
+	atomic_uint scrapes;
+} system_metrics_t;
+
+// Registers /metrics on the web system's httpd instance, call after system_web_init()
+esp_err_t system_metrics_init(system_metrics_t *system);
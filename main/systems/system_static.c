@@ -0,0 +1,252 @@
+#include "system_static.h"
+#include "myware/myware_spiffs.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <esp_log.h>
+#include <esp_http_server.h>
+
+// Base path, the URI and ".gz"
+#define SYSTEM_STATIC_PATH_MAX (sizeof(MYWARE_SPIFFS_BASE_PATH) + CONFIG_HTTPD_MAX_URI_LEN + 3)
+
+typedef struct {
+	const char *ext;
+	const char *type;
+} private_type_t;
+
+static const private_type_t private_types[] = {
+{".html", "text/html; charset=utf-8"},
+{".htm", "text/html; charset=utf-8"},
+{".js", "text/javascript; charset=utf-8"},
+{".css", "text/css; charset=utf-8"},
+{".json", "application/json"},
+{".txt", "text/plain; charset=utf-8"},
+{".csv", "text/csv; charset=utf-8"},
+{".svg", "image/svg+xml"},
+{".png", "image/png"},
+{".jpg", "image/jpeg"},
+{".jpeg", "image/jpeg"},
+{".gif", "image/gif"},
+{".ico", "image/x-icon"},
+{".wasm", "application/wasm"},
+};
+
+static const char *private_content_type(const char *path)
+{
+	const char *ext = strrchr(path, '.');
+	if (ext == NULL) {
+		return "application/octet-stream";
+	}
+	for (size_t i = 0; i < sizeof(private_types) / sizeof(private_types[0]); i++) {
+		if (strcasecmp(ext, private_types[i].ext) == 0) {
+			return private_types[i].type;
+		}
+	}
+	return "application/octet-stream";
+}
+
+// Maps the URI to a path on the partition, the query is cut and ".." is refused
+static esp_err_t private_path(const char *uri, char *path, size_t size)
+{
+	size_t len = strcspn(uri, "?#");
+	if (len == 0 || uri[0] != '/') {
+		return ESP_ERR_INVALID_ARG;
+	}
+	for (const char *p = uri; p < (uri + len); p++) {
+		if (p[0] == '.' && p[1] == '.' && (p == uri || p[-1] == '/')) {
+			return ESP_ERR_INVALID_ARG;
+		}
+	}
+	const char *index = (uri[len - 1] == '/') ? "index.html" : "";
+	int n = snprintf(path, size, "%s%.*s%s", MYWARE_SPIFFS_BASE_PATH, (int)len, uri, index);
+	if (n < 0 || (size_t)n >= size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	return ESP_OK;
+}
+
+static bool private_header_contains(httpd_req_t *req, const char *field, const char *value)
+{
+	char buf[128];
+	if (httpd_req_get_hdr_value_str(req, field, buf, sizeof(buf)) != ESP_OK) {
+		return false;
+	}
+	return strstr(buf, value) != NULL;
+}
+
+// Parses a single "bytes=a-b", "bytes=a-" or "bytes=-n" range into [*first, *last].
+// Returns ESP_ERR_NOT_FOUND when the header should be ignored and the whole file sent,
+// ESP_ERR_INVALID_SIZE when the range is outside the file.
+static esp_err_t private_range(const char *header, size_t size, size_t *first, size_t *last)
+{
+	if (strncmp(header, "bytes=", 6) != 0 || strchr(header, ',') != NULL) {
+		// Other units and multiple ranges are not supported, the full response is allowed for both
+		return ESP_ERR_NOT_FOUND;
+	}
+	const char *p = header + 6;
+	char *end;
+	if (*p == '-') {
+		unsigned long suffix = strtoul(p + 1, &end, 10);
+		if (end == (p + 1) || *end != '\0') {
+			return ESP_ERR_NOT_FOUND;
+		}
+		if (suffix == 0 || size == 0) {
+			return ESP_ERR_INVALID_SIZE;
+		}
+		*first = (suffix < size) ? (size - suffix) : 0;
+		*last = size - 1;
+		return ESP_OK;
+	}
+	unsigned long a = strtoul(p, &end, 10);
+	if (end == p || *end != '-') {
+		return ESP_ERR_NOT_FOUND;
+	}
+	p = end + 1;
+	unsigned long b = size - 1;
+	if (*p != '\0') {
+		b = strtoul(p, &end, 10);
+		if (end == p || *end != '\0' || b < a) {
+			return ESP_ERR_NOT_FOUND;
+		}
+	}
+	if (a >= size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	*first = a;
+	*last = (b < size) ? b : (size - 1);
+	return ESP_OK;
+}
+
+static esp_err_t private_static_handler(httpd_req_t *req)
+{
+	system_static_t *system = req->user_ctx;
+	atomic_fetch_add(&system->requests, 1);
+
+	char path[SYSTEM_STATIC_PATH_MAX];
+	if (private_path(req->uri, path, sizeof(path) - 3) != ESP_OK) {
+		return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bad path");
+	}
+	const char *type = private_content_type(path);
+
+	// A precompressed variant is sent as is to clients that take gzip
+	struct stat st;
+	bool gzip = false;
+	size_t len = strlen(path);
+	if (private_header_contains(req, "Accept-Encoding", "gzip")) {
+		strcpy(path + len, ".gz");
+		gzip = (stat(path, &st) == 0 && S_ISREG(st.st_mode));
+	}
+	if (gzip == false) {
+		path[len] = '\0';
+		if (stat(path, &st) != 0 || S_ISREG(st.st_mode) == false) {
+			return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "not found");
+		}
+	}
+	size_t size = st.st_size;
+
+	// Size and mtime change whenever the file is rewritten, the gzip variant has its own tag
+	char etag[40];
+	snprintf(etag, sizeof(etag), "\"%zx-%" PRIx64 "%s\"", size, (uint64_t)st.st_mtime, gzip ? "-gz" : "");
+	httpd_resp_set_hdr(req, "ETag", etag);
+	httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+	httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+	httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+	if (private_header_contains(req, "If-None-Match", etag)) {
+		httpd_resp_set_status(req, "304 Not Modified");
+		return httpd_resp_send(req, NULL, 0);
+	}
+	httpd_resp_set_type(req, type);
+	if (gzip) {
+		httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+	}
+
+	size_t first = 0;
+	size_t last = size - 1;
+	bool partial = false;
+	// Headers are sent by the first chunk, the buffers below must live until then
+	char content_range[48];
+	char range[64];
+	if (size > 0 && httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK) {
+		// If-Range with another tag, or a date since no Last-Modified is sent, means the client's part may be stale
+		char if_range[48];
+		bool stale = httpd_req_get_hdr_value_str(req, "If-Range", if_range, sizeof(if_range)) == ESP_OK && strcmp(if_range, etag) != 0;
+		esp_err_t e = stale ? ESP_ERR_NOT_FOUND : private_range(range, size, &first, &last);
+		if (e == ESP_ERR_INVALID_SIZE) {
+			snprintf(content_range, sizeof(content_range), "bytes */%zu", size);
+			httpd_resp_set_hdr(req, "Content-Range", content_range);
+			httpd_resp_set_status(req, "416 Range Not Satisfiable");
+			return httpd_resp_send(req, NULL, 0);
+		}
+		if (e == ESP_OK) {
+			partial = true;
+			snprintf(content_range, sizeof(content_range), "bytes %zu-%zu/%zu", first, last, size);
+			httpd_resp_set_hdr(req, "Content-Range", content_range);
+			httpd_resp_set_status(req, "206 Partial Content");
+		}
+	}
+	if (size == 0) {
+		return httpd_resp_send(req, NULL, 0);
+	}
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		ESP_LOGE(__func__, "fopen(%s) failed", path);
+		return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "open failed");
+	}
+	if (partial && fseek(f, first, SEEK_SET) != 0) {
+		ESP_LOGE(__func__, "fseek(%s, %zu) failed", path, first);
+		fclose(f);
+		return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "seek failed");
+	}
+	size_t remaining = last - first + 1;
+	esp_err_t e = ESP_OK;
+	while (remaining > 0) {
+		size_t want = (remaining < sizeof(system->chunk)) ? remaining : sizeof(system->chunk);
+		size_t n = fread(system->chunk, 1, want, f);
+		if (n == 0) {
+			ESP_LOGE(__func__, "fread(%s) failed with %zu bytes left", path, remaining);
+			e = ESP_FAIL;
+			break;
+		}
+		e = httpd_resp_send_chunk(req, system->chunk, n);
+		if (e != ESP_OK) {
+			ESP_LOGW(__func__, "httpd_resp_send_chunk() failed with %d", e);
+			break;
+		}
+		remaining -= n;
+	}
+	fclose(f);
+	if (e != ESP_OK) {
+		// The status line is already out, dropping the connection is the only way to tell the client
+		return ESP_FAIL;
+	}
+	return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t system_static_init(system_static_t *system)
+{
+	if (system->web == NULL || system->web->server == NULL) {
+		ESP_LOGE(__func__, "web server is not running");
+		return ESP_ERR_INVALID_STATE;
+	}
+	esp_err_t e = Myware_spiffs_mount();
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "Myware_spiffs_mount() failed with %d", e);
+		return e;
+	}
+	httpd_uri_t uri_static = {
+	.uri = "/*",
+	.method = HTTP_GET,
+	.handler = private_static_handler,
+	.user_ctx = system};
+	e = httpd_register_uri_handler(system->web->server, &uri_static);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "httpd_register_uri_handler() failed with %d", e);
+		return e;
+	}
+	return ESP_OK;
+}
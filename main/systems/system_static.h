@@ -0,0 +1,17 @@
+#pragma once
+#include <sdkconfig.h>
+#include <esp_err.h>
+#include <stdatomic.h>
+#include "systems/system_web.h"
+
+// Serves the files of the storage partition on every URI no other handler took
+typedef struct {
+	system_web_t *web;
+	atomic_uint requests;
+	// Only the httpd task uses it, requests are handled one at a time
+	char chunk[CONFIG_SYSTEM_STATIC_CHUNK_SIZE];
+} system_static_t;
+
+// Mounts the storage partition and registers /* on the web system's httpd instance.
+// Call after every other handler is registered, the wildcard would shadow handlers registered after it.
+esp_err_t system_static_init(system_static_t *system);
@@ -11,11 +11,14 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <freertos/portmacro.h>
 
+#if !CONFIG_IDF_TARGET_LINUX
 #include <driver/uart.h>
 #include <driver/uart_vfs.h>
 #include <driver/usb_serial_jtag.h>
+#endif
 
 #include <esp_log.h>
 #include <linenoise/linenoise.h>
@@ -23,11 +26,26 @@
 #include "console/console_nvs.h"
 #include "console/console_wifi.h"
 #include "console/console_os.h"
+#include "console/console_bench.h"
 #include "console/console_web.h"
+#include "console/console_log.h"
 
 #define CONSOLE_MAX_CMDLINE_ARGS   8
 #define CONSOLE_MAX_CMDLINE_LENGTH 256
 
+// esp_console and the argtables of the commands are shared by every task that runs commands
+static SemaphoreHandle_t private_run_lock = NULL;
+// Output of the command holding private_run_lock
+static FILE *private_out = NULL;
+
+#if CONFIG_IDF_TARGET_LINUX
+static esp_err_t private_uart_init(system_term_t *system)
+{
+	// The console reads the process's stdin
+	setvbuf(stdin, NULL, _IONBF, 0);
+	return ESP_OK;
+}
+#else
 static esp_err_t private_uart_init(system_term_t *system)
 {
 	// Disable loggin when reconfiguring uart0:
@@ -70,6 +88,7 @@ static esp_err_t private_uart_init(system_term_t *system)
 	// Loggin enabled from here
 	return e;
 }
+#endif
 
 static void private_console_init(system_term_t *system)
 {
@@ -82,6 +101,8 @@ static void private_console_init(system_term_t *system)
 #endif
 	};
 	ESP_ERROR_CHECK(esp_console_init(&console_config));
+	private_run_lock = xSemaphoreCreateMutex();
+	assert(private_run_lock != NULL);
 
 	/* Configure linenoise line completion library */
 	/* Enable multiline editing. If not set, long commands will scroll within
@@ -116,10 +137,36 @@ static void private_console_init(system_term_t *system)
 	esp_console_register_help_command();
 }
 
+FILE *system_term_out(void)
+{
+	return (private_out != NULL) ? private_out : stdout;
+}
+
+esp_err_t system_term_run(char const *line, FILE *out)
+{
+	/* Try to run the command */
+	int ret;
+	xSemaphoreTake(private_run_lock, portMAX_DELAY);
+	private_out = out;
+	esp_err_t err = esp_console_run(line, &ret);
+	private_out = NULL;
+	xSemaphoreGive(private_run_lock);
+	if (err == ESP_ERR_NOT_FOUND) {
+		fprintf(out, "Unrecognized command\n");
+	} else if (err == ESP_ERR_INVALID_ARG) {
+		// command was empty
+	} else if (err == ESP_OK && ret != ESP_OK) {
+		fprintf(out, "Command returned non-zero error code: 0x%x (%s)\n", ret, esp_err_to_name(ret));
+	} else if (err != ESP_OK) {
+		fprintf(out, "Internal error: %s\n", esp_err_to_name(err));
+	}
+	return err;
+}
+
 static void private_task_term(system_term_t *system)
 {
 	assert(system != NULL);
-	ESP_LOGI(__func__, "begin reading uart %i", UART_NUM_0);
+	ESP_LOGI(__func__, "begin reading the console");
 	for (;;) {
 		char *line = linenoise(LOG_COLOR_I CONFIG_IDF_TARGET ">" LOG_RESET_COLOR);
 		// vTaskDelay(pdMS_TO_TICKS(5000));
@@ -137,18 +184,7 @@ static void private_task_term(system_term_t *system)
 			// linenoiseHistorySave(HISTORY_PATH);
 		}
 
-		/* Try to run the command */
-		int ret;
-		esp_err_t err = esp_console_run(line, &ret);
-		if (err == ESP_ERR_NOT_FOUND) {
-			printf("Unrecognized command\n");
-		} else if (err == ESP_ERR_INVALID_ARG) {
-			// command was empty
-		} else if (err == ESP_OK && ret != ESP_OK) {
-			printf("Command returned non-zero error code: 0x%x (%s)\n", ret, esp_err_to_name(ret));
-		} else if (err != ESP_OK) {
-			printf("Internal error: %s\n", esp_err_to_name(err));
-		}
+		system_term_run(line, stdout);
 		/* linenoise allocates line buffer on the heap, so need to free it */
 		linenoiseFree(line);
 	}
@@ -168,7 +204,9 @@ void system_term_init(system_term_t *system)
 	console_nvs_init();
 	console_wifi_init();
 	console_os_init();
-	console_web_init();
+	console_bench_init(system->log, system->web);
+	console_web_init(system->web);
+	console_log_init(system->log);
 
 	if (linenoiseIsDumbMode()) {
 		printf("\n"
@@ -1,7 +1,20 @@
 #pragma once
 
+#include <stdio.h>
+#include <esp_err.h>
+#include "systems/system_web.h"
+#include "systems/system_log.h"
+
 typedef struct {
-	int dummmy;
+	system_web_t *web;
+	system_log_t *log;
 } system_term_t;
 
 void system_term_init(system_term_t *system);
+
+// Runs one command line, serialized with every other caller. Output goes to out.
+esp_err_t system_term_run(char const *line, FILE *out);
+
+// Where the running command prints, commands use it instead of stdout and stderr.
+// Those are per task on newlib but process wide on the linux target.
+FILE *system_term_out(void);
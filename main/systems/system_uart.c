@@ -0,0 +1,67 @@
+#include "system_uart.h"
+
+#include <esp_log.h>
+#include <freertos/task.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include <unistd.h>
+#else
+#include <driver/uart.h>
+#endif
+#include <esp_timer.h>
+
+static int private_write(const char *data, size_t len)
+{
+#if CONFIG_IDF_TARGET_LINUX
+	// The process's stdout stands in for UART0
+	return write(STDOUT_FILENO, data, len);
+#else
+	return uart_write_bytes(UART_NUM_0, data, len);
+#endif
+}
+
+static void private_task_my_uart(system_uart_t *system)
+{
+	assert(system != NULL);
+	unsigned dropped_seen = 0;
+	unsigned bytes_dropped_seen = 0;
+	while (1) {
+		system_log_record_t *record = system_log_receive(system->log, &system->sink, portMAX_DELAY);
+		if (record == NULL) {
+			continue;
+		}
+		// Only this task waits for the serial line
+		int n = private_write(record->text, record->text_len);
+		if (n > 0) {
+			atomic_fetch_add(&system->bytes_written, n);
+		}
+		system_log_release(system->log, &system->sink, record);
+		unsigned dropped = atomic_load(&system->sink.records_dropped);
+		if (dropped != dropped_seen) {
+			unsigned bytes_dropped = atomic_load(&system->sink.bytes_dropped);
+			char notice[64];
+			int notice_len = snprintf(notice, sizeof(notice), "[uart: %u log lines, %u bytes dropped]\n", dropped - dropped_seen, bytes_dropped - bytes_dropped_seen);
+			private_write(notice, notice_len);
+			dropped_seen = dropped;
+			bytes_dropped_seen = bytes_dropped;
+		}
+	}
+	vTaskDelete(NULL);
+}
+
+esp_err_t system_uart_init(system_uart_t *system)
+{
+	system->sink.name = "uart";
+	system->sink.level = CONFIG_SYSTEM_UART_LOG_LEVEL;
+#if CONFIG_SYSTEM_UART_POLICY_BLOCK
+	system->sink.block = true;
+#endif
+	esp_err_t e = system_log_sink_add(system->log, &system->sink);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "system_log_sink_add() failed with %d", e);
+		return e;
+	}
+	// Below the tasks that log the most, so bursts are queued instead of written while they run
+	xTaskCreate((TaskFunction_t)private_task_my_uart, "my_uart", 1024 * 3, system, 5, NULL);
+	system->started_us = esp_timer_get_time();
+	return ESP_OK;
+}
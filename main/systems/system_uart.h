@@ -0,0 +1,16 @@
+#pragma once
+#include <sdkconfig.h>
+#include <esp_err.h>
+#include <stdatomic.h>
+#include "systems/system_log.h"
+
+typedef struct {
+	system_log_t *log;
+	// Formatted log text, written to UART0 by my_uart
+	system_log_sink_t sink;
+	atomic_uint bytes_written;
+	int64_t started_us;
+} system_uart_t;
+
+// Call after UART0's driver is installed
+esp_err_t system_uart_init(system_uart_t *system);
@@ -0,0 +1,85 @@
+#include "system_udp.h"
+
+#include <string.h>
+#include <errno.h>
+#include <sys/param.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#else
+#include <lwip/sockets.h>
+#include <lwip/inet.h>
+#endif
+
+static void private_send(system_udp_t *system, const char *data, size_t len)
+{
+	struct sockaddr_in dest = {
+	.sin_family = AF_INET,
+	.sin_port = htons(system->port),
+	.sin_addr.s_addr = system->addr,
+	};
+	if (sendto(system->sock, data, len, 0, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+		// Usually no network yet, logging the error here would only feed this sink
+		atomic_fetch_add(&system->send_errors, 1);
+		return;
+	}
+	atomic_fetch_add(&system->datagrams_sent, 1);
+}
+
+static void private_task_my_udp(system_udp_t *system)
+{
+	assert(system != NULL);
+	static char datagram[CONFIG_SYSTEM_UDP_DATAGRAM_SIZE];
+	size_t len = 0;
+	while (1) {
+		// Wait for the first line, then take whatever else is already there
+		TickType_t timeout = (len == 0) ? portMAX_DELAY : 0;
+		system_log_record_t *record = system_log_receive(system->log, &system->sink, timeout);
+		if (record == NULL) {
+			if (len > 0) {
+				private_send(system, datagram, len);
+				len = 0;
+			}
+			continue;
+		}
+		size_t n = MIN(record->text_len, sizeof(datagram));
+		if (len + n > sizeof(datagram)) {
+			private_send(system, datagram, len);
+			len = 0;
+		}
+		memcpy(datagram + len, record->text, n);
+		len += n;
+		system_log_release(system->log, &system->sink, record);
+	}
+	vTaskDelete(NULL);
+}
+
+esp_err_t system_udp_init(system_udp_t *system, const char *host, uint16_t port)
+{
+	struct in_addr addr;
+	if (inet_aton(host, &addr) == 0) {
+		ESP_LOGE(__func__, "'%s' is not an IPv4 address", host);
+		return ESP_ERR_INVALID_ARG;
+	}
+	system->addr = addr.s_addr;
+	system->port = port;
+	system->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (system->sock < 0) {
+		ESP_LOGE(__func__, "socket() failed with errno %d", errno);
+		return ESP_FAIL;
+	}
+	system->sink.name = "udp";
+	system->sink.level = CONFIG_SYSTEM_UDP_LOG_LEVEL;
+	esp_err_t e = system_log_sink_add(system->log, &system->sink);
+	if (e != ESP_OK) {
+		ESP_LOGE(__func__, "system_log_sink_add() failed with %d", e);
+		return e;
+	}
+	xTaskCreate((TaskFunction_t)private_task_my_udp, "my_udp", 1024 * 3, system, 4, NULL);
+	system->started_us = esp_timer_get_time();
+	return ESP_OK;
+}
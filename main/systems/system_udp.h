@@ -0,0 +1,21 @@
+#pragma once
+#include <sdkconfig.h>
+#include <esp_err.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "systems/system_log.h"
+
+typedef struct {
+	system_log_t *log;
+	// Log lines sent as UDP datagrams by my_udp, several lines per datagram
+	system_log_sink_t sink;
+	int sock;
+	uint32_t addr;
+	uint16_t port;
+	atomic_uint datagrams_sent;
+	atomic_uint send_errors;
+	int64_t started_us;
+} system_udp_t;
+
+// host is an IPv4 address, lines are sent there once the network is up
+esp_err_t system_udp_init(system_udp_t *system, const char *host, uint16_t port);
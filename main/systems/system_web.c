@@ -1,86 +1,981 @@
+// fopencookie()
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include "system_web.h"
+#include "system_term.h"
+#include "myware/myware_log.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/param.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <esp_http_server.h>
+#include <freertos/task.h>
+
+// Entry of the history ring, followed by tag_size bytes of the tag with its NUL, then len bytes: the body of a log line,
+// a whole line that is not ESP_LOGx output, or a Myware_log_trace() payload
+typedef struct {
+	uint16_t len;
+	uint8_t level;
+	bool trace;
+	uint32_t timestamp;
+	// 0 for lines that are not ESP_LOGx output
+	uint8_t tag_size;
+	// Body format of a trace payload, which is formatted on replay
+	const char *fmt;
+} system_web_history_t;
+
+// Item in rb_rx: a command line received on the session fd
+typedef struct {
+	int fd;
+	char line[];
+} system_web_rx_t;
+
+// How long command output waits for a free frame and for room in the session's queue
+#define SYSTEM_WEB_REPLY_TIMEOUT_MS 1000
+
+static system_web_frame_t *private_frame_acquire(system_web_t *system, TickType_t timeout)
+{
+	system_web_frame_t *frame = NULL;
+	if (xQueueReceive(system->frames_free, &frame, timeout) != pdTRUE) {
+		return NULL;
+	}
+	atomic_store(&frame->refs, 1);
+	frame->binary = false;
+	frame->keep = false;
+	frame->tags = 0;
+	frame->clients = 0;
+	frame->enqueued_us = 0;
+	frame->len = 0;
+	return frame;
+}
+
+static void private_frame_release(system_web_t *system, system_web_frame_t *frame)
+{
+	if (atomic_fetch_sub(&frame->refs, 1) == 1) {
+		xQueueSend(system->frames_free, &frame, 0);
+	}
+}
+
+static void private_queue_drain(system_web_t *system, QueueHandle_t queue)
+{
+	system_web_frame_t *frame;
+	while (xQueueReceive(queue, &frame, 0) == pdTRUE) {
+		private_frame_release(system, frame);
+	}
+}
+
+static void private_subs_update(system_web_t *system)
+{
+	// Called with subs_lock held, the most verbose level any client subscribed to
+	uint32_t level_max = 0;
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active == false) {
+			continue;
+		}
+		level_max = MAX(level_max, client->sub_level);
+		for (int j = 0; j < CONFIG_SYSTEM_WEB_SUBS_MAX; j++) {
+			if (client->subs[j].tag[0] != '\0') {
+				level_max = MAX(level_max, client->subs[j].level);
+			}
+		}
+	}
+	atomic_store(&system->subs_level_max, level_max);
+}
+
+static esp_err_t private_client_add(system_web_t *system, int fd)
+{
+	esp_err_t e = ESP_ERR_NO_MEM;
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active == false) {
+			// Whatever is left belongs to the previous session of this slot
+			private_queue_drain(system, client->queue);
+			client->active = true;
+			client->fd = fd;
+			client->bytes_queued = 0;
+			client->bytes_sent = 0;
+			client->bytes_dropped = 0;
+			Myware_hist_reset(&client->latency);
+			client->binary = false;
+			client->tags_sent = 0;
+			// my_web replays the history before the client joins the live stream
+			client->history_pending = true;
+			client->history_pos = 0;
+			client->joined_ms = esp_log_timestamp();
+			// New sessions get everything until they subscribe
+			taskENTER_CRITICAL(&system->subs_lock);
+			client->sub_level = ESP_LOG_VERBOSE;
+			memset(client->subs, 0, sizeof(client->subs));
+			private_subs_update(system);
+			taskEXIT_CRITICAL(&system->subs_lock);
+			e = ESP_OK;
+			break;
+		}
+	}
+	xSemaphoreGive(system->clients_lock);
+	return e;
+}
+
+static void private_client_remove(system_web_t *system, int fd)
+{
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active && client->fd == fd) {
+			client->active = false;
+		}
+	}
+	taskENTER_CRITICAL(&system->subs_lock);
+	private_subs_update(system);
+	taskEXIT_CRITICAL(&system->subs_lock);
+	xSemaphoreGive(system->clients_lock);
+}
+
+static system_web_client_t *private_client_find(system_web_t *system, int fd)
+{
+	system_web_client_t *found = NULL;
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active && client->fd == fd) {
+			found = client;
+			break;
+		}
+	}
+	xSemaphoreGive(system->clients_lock);
+	return found;
+}
+
+static esp_err_t private_on_open(httpd_handle_t hd, int sockfd)
+{
+	// The fd may be reused from a session that was never seen closing
+	private_client_remove(httpd_get_global_user_ctx(hd), sockfd);
+	return ESP_OK;
+}
+
+static void private_on_close(httpd_handle_t hd, int sockfd)
+{
+	private_client_remove(httpd_get_global_user_ctx(hd), sockfd);
+	// httpd leaves closing the socket to close_fn
+	close(sockfd);
+}
+
+// frontend1/index.html, gzipped at build time and embedded in rodata
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+
+static esp_err_t private_index_handler(httpd_req_t *req)
+{
+	system_web_t *system = req->user_ctx;
+	httpd_resp_set_hdr(req, "ETag", system->index_etag);
+	// Cached, but revalidated on every load, which costs one bodyless 304 while the firmware is unchanged
+	httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+	char match[64];
+	if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK && strstr(match, system->index_etag) != NULL) {
+		httpd_resp_set_status(req, "304 Not Modified");
+		return httpd_resp_send(req, NULL, 0);
+	}
+	httpd_resp_set_type(req, "text/html; charset=utf-8");
+	httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+	// Sent straight from flash, nothing is copied to RAM first
+	return httpd_resp_send(req, (const char *)index_html_gz_start, index_html_gz_end - index_html_gz_start);
+}
+
+static void private_no_free(void *ctx)
+{
+	// system_web_t is not owned by httpd
+}
 
 static esp_err_t echo_handler(httpd_req_t *req)
 {
 	if (req->method == HTTP_GET) {
+		int fd = httpd_req_to_sockfd(req);
+		esp_err_t e = private_client_add(req->user_ctx, fd);
+		if (e != ESP_OK) {
+			ESP_LOGW(__func__, "No free client slot for fd %d", fd);
+			return e;
+		}
 		ESP_LOGI(__func__, "Handshake done, the new connection was opened");
 		return ESP_OK;
 	}
 
+	system_web_t *system = req->user_ctx;
+	int fd = httpd_req_to_sockfd(req);
+	system_web_client_t *client = private_client_find(system, fd);
+	if (client == NULL) {
+		ESP_LOGW(__func__, "fd %d is not a registered client", fd);
+		return ESP_FAIL;
+	}
+
 	httpd_ws_frame_t ws_pkt;
-	uint8_t *buf = NULL;
 	memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-	ws_pkt.type = HTTPD_WS_TYPE_TEXT;
-	/* Set max_len = 0 to get the frame len */
-	esp_err_t ret = httpd_ws_recv_frame(req, &ws_pkt, 0);
-	if (ret != ESP_OK) {
-		ESP_LOGE(__func__, "httpd_ws_recv_frame failed to get frame len with %d", ret);
-		return ret;
-	}
-	ESP_LOGI(__func__, "frame len is %d", ws_pkt.len);
-	if (ws_pkt.len) {
-		/* ws_pkt.len + 1 is for NULL termination as we are expecting a string */
-		buf = calloc(1, ws_pkt.len + 1);
-		if (buf == NULL) {
-			ESP_LOGE(__func__, "Failed to calloc memory for buf");
+	ws_pkt.payload = client->rx;
+	/* Header and payload in one call when the frame fits the session buffer */
+	esp_err_t ret = httpd_ws_recv_frame(req, &ws_pkt, sizeof(client->rx) - 1);
+	if (ret == ESP_ERR_INVALID_SIZE && ws_pkt.len <= CONFIG_SYSTEM_WEB_RX_MAX) {
+		/* ws_pkt.len is known now, the next call only reads the payload */
+		ws_pkt.payload = malloc(ws_pkt.len + 1);
+		if (ws_pkt.payload == NULL) {
+			ESP_LOGE(__func__, "Failed to malloc %u bytes for oversized frame", (unsigned)ws_pkt.len);
 			return ESP_ERR_NO_MEM;
 		}
-		ws_pkt.payload = buf;
-		/* Set max_len = ws_pkt.len to get the frame payload */
 		ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
-		if (ret != ESP_OK) {
-			ESP_LOGE(__func__, "httpd_ws_recv_frame failed with %d", ret);
-			free(buf);
-			return ret;
+	}
+	if (ret != ESP_OK) {
+		ESP_LOGE(__func__, "httpd_ws_recv_frame failed with %d, frame len %u", ret, (unsigned)ws_pkt.len);
+	} else if (ws_pkt.type == HTTPD_WS_TYPE_TEXT) {
+		// Commands run on my_wsrx so that a slow command does not block the httpd task
+		system_web_rx_t *item = NULL;
+		if (xRingbufferSendAcquire(system->rb_rx, (void **)&item, sizeof(system_web_rx_t) + ws_pkt.len + 1, 0) == pdTRUE) {
+			item->fd = fd;
+			memcpy(item->line, ws_pkt.payload, ws_pkt.len);
+			item->line[ws_pkt.len] = '\0';
+			xRingbufferSendComplete(system->rb_rx, item);
+		} else {
+			ESP_LOGW(__func__, "rb_rx is full, dropped command from fd %d", fd);
 		}
-		ESP_LOGI(__func__, "Got packet with message: %s,,, %i", ws_pkt.payload, strcmp((char *)ws_pkt.payload, "Trigger async"));
-		free(buf);
+	}
+	if (ws_pkt.payload != client->rx) {
+		free(ws_pkt.payload);
 	}
 	return ret;
 }
 
-static esp_err_t print_all_ws_fds(httpd_handle_t server, uint8_t *buf, size_t buf_len)
+static bool private_client_enqueue(system_web_t *system, system_web_client_t *client, system_web_frame_t *frame)
 {
-	size_t n = CONFIG_LWIP_MAX_LISTENING_TCP;
-	int fds[CONFIG_LWIP_MAX_LISTENING_TCP] = {0};
-	esp_err_t ret = httpd_get_client_list(server, &n, fds);
-	if (ret != ESP_OK) {
-		return ret;
+	// Called with clients_lock held, never blocks. Returns false when the frame was dropped.
+	atomic_fetch_add(&frame->refs, 1);
+	if (xQueueSend(client->queue, &frame, 0) == pdTRUE) {
+		client->bytes_queued += frame->len;
+		return true;
+	}
+	switch (system->policy) {
+	case SYSTEM_WEB_POLICY_DROP_OLDEST: {
+		// Frames to keep are put back in front in their order, the sender only takes frames under clients_lock
+		system_web_frame_t *kept[CONFIG_SYSTEM_WEB_CLIENT_QUEUE_LEN];
+		int kept_len = 0;
+		system_web_frame_t *oldest = NULL;
+		while (kept_len < CONFIG_SYSTEM_WEB_CLIENT_QUEUE_LEN && xQueueReceive(client->queue, &oldest, 0) == pdTRUE) {
+			if (oldest->keep == false) {
+				break;
+			}
+			kept[kept_len++] = oldest;
+			oldest = NULL;
+		}
+		while (kept_len > 0) {
+			xQueueSendToFront(client->queue, &kept[--kept_len], 0);
+		}
+		if (oldest != NULL) {
+			client->bytes_dropped += oldest->len;
+			private_frame_release(system, oldest);
+			if (xQueueSend(client->queue, &frame, 0) == pdTRUE) {
+				client->bytes_queued += frame->len;
+				return true;
+			}
+		}
+	} break;
+	case SYSTEM_WEB_POLICY_DISCONNECT:
+		httpd_sess_trigger_close(system->server, client->fd);
+		break;
+	case SYSTEM_WEB_POLICY_DROP_NEWEST:
+	default:
+		break;
+	}
+	client->bytes_dropped += frame->len;
+	private_frame_release(system, frame);
+	return false;
+}
+
+static size_t private_varint(uint8_t *p, uint32_t value)
+{
+	size_t n = 0;
+	while (value >= 0x80) {
+		p[n++] = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	p[n++] = value;
+	return n;
+}
+
+static bool private_dict_queue(system_web_t *system, system_web_client_t *client, system_web_frame_t *frame)
+{
+	// The records queued after a dictionary frame need it, the drop policy never evicts it
+	frame->keep = true;
+	bool queued = private_client_enqueue(system, client, frame);
+	if (queued) {
+		client->tags_sent |= frame->tags;
+	}
+	private_frame_release(system, frame);
+	return queued;
+}
+
+static bool private_dict_send(system_web_t *system, system_web_client_t *client, uint64_t tags)
+{
+	// Called with clients_lock held, tells a binary client the names of tags it has not seen.
+	// A tag only counts as sent once its frame is queued, false when some of them could not be.
+	system_web_frame_t *frame = NULL;
+	for (int id = 1; id <= system->tags_len; id++) {
+		if ((tags & (1ULL << (id - 1))) == 0) {
+			continue;
+		}
+		const char *name = system->tags[id - 1];
+		size_t name_len = MIN(strlen(name), 255);
+		if (frame != NULL && (frame->len + 10 + name_len) > sizeof(frame->data)) {
+			if (private_dict_queue(system, client, frame) == false) {
+				return false;
+			}
+			frame = NULL;
+		}
+		if (frame == NULL) {
+			frame = private_frame_acquire(system, 0);
+			if (frame == NULL) {
+				return false;
+			}
+			frame->binary = true;
+			frame->data[frame->len++] = SYSTEM_WEB_BIN_DICT;
+		}
+		frame->len += private_varint(frame->data + frame->len, id);
+		frame->len += private_varint(frame->data + frame->len, name_len);
+		memcpy(frame->data + frame->len, name, name_len);
+		frame->len += name_len;
+		frame->tags |= 1ULL << (id - 1);
+	}
+	if (frame != NULL) {
+		return private_dict_queue(system, client, frame);
+	}
+	return true;
+}
+
+static esp_err_t print_all_ws_fds(system_web_t *system, system_web_frame_t *frame)
+{
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active == false || client->history_pending || client->binary != frame->binary) {
+			continue;
+		}
+		if ((frame->clients & (1u << i)) == 0) {
+			continue;
+		}
+		uint64_t tags_new = frame->tags & ~client->tags_sent;
+		if (tags_new && private_dict_send(system, client, tags_new) == false) {
+			// Records with tag ids the client cannot resolve are worth nothing, the dictionary is tried again with the next frame
+			client->bytes_dropped += frame->len;
+			continue;
+		}
+		private_client_enqueue(system, client, frame);
 	}
-	for (int i = 0; i < n; i++) {
-		httpd_ws_client_info_t info = httpd_ws_get_fd_info(server, fds[i]);
-		if (info == HTTPD_WS_CLIENT_WEBSOCKET) {
-			printf("ws-fd: %d\n", fds[i]);
+	xSemaphoreGive(system->clients_lock);
+	return ESP_OK;
+}
+
+static void private_task_my_wsclient(system_web_client_t *client)
+{
+	assert(client != NULL);
+	system_web_t *system = client->system;
+	while (1) {
+		system_web_frame_t *frame;
+		if (xQueuePeek(client->queue, &frame, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+		// Taken under clients_lock, the drop policy may have rotated the queue since the peek
+		xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+		bool taken = (xQueueReceive(client->queue, &frame, 0) == pdTRUE);
+		bool active = client->active;
+		int fd = client->fd;
+		xSemaphoreGive(system->clients_lock);
+		if (taken == false) {
+			continue;
+		}
+		if (active) {
+			// Blocks only this client's task when its socket is slow
 			httpd_ws_frame_t pkt;
 			memset(&pkt, 0, sizeof(httpd_ws_frame_t));
-			pkt.payload = (uint8_t *)buf;
-			pkt.len = buf_len;
-			pkt.type = HTTPD_WS_TYPE_TEXT;
-			httpd_ws_send_frame_async(server, fds[i], &pkt);
+			pkt.payload = frame->data;
+			pkt.len = frame->len;
+			pkt.type = frame->binary ? HTTPD_WS_TYPE_BINARY : HTTPD_WS_TYPE_TEXT;
+			if (httpd_ws_send_frame_async(system->server, fd, &pkt) == ESP_OK) {
+				client->bytes_sent += frame->len;
+				// The send is synchronous, the frame is on the socket now
+				if (frame->enqueued_us != 0) {
+					Myware_hist_record(&client->latency, (uint32_t)esp_timer_get_time() - frame->enqueued_us);
+				}
+			} else {
+				client->bytes_dropped += frame->len;
+				if (frame->binary && frame->data[0] == SYSTEM_WEB_BIN_DICT) {
+					// The client never got these names, they go out again with the next records that use them
+					xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+					if (client->active && client->fd == fd) {
+						client->tags_sent &= ~frame->tags;
+					}
+					xSemaphoreGive(system->clients_lock);
+				}
+			}
 		}
+		// The frame outlives the ring item until the last client has sent it
+		private_frame_release(system, frame);
 	}
-	return ESP_OK;
+	vTaskDelete(NULL);
 }
 
-static void private_task_my_wstx(system_web_t *system)
+static system_web_client_t *private_client_session_locked(system_web_t *system)
+{
+	// Called with clients_lock held, the client whose command my_wsrx is running
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active && client->fd == system->rx_fd) {
+			return client;
+		}
+	}
+	return NULL;
+}
+
+static bool private_reply_enqueue(system_web_t *system, system_web_frame_t *frame)
+{
+	// Waits for room instead of applying the drop policy, polled so that clients_lock is never held while waiting
+	TickType_t start = xTaskGetTickCount();
+	while (1) {
+		xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+		system_web_client_t *client = private_client_session_locked(system);
+		bool queued = (client != NULL && xQueueSend(client->queue, &frame, 0) == pdTRUE);
+		if (queued) {
+			client->bytes_queued += frame->len;
+		}
+		xSemaphoreGive(system->clients_lock);
+		if (queued) {
+			return true;
+		}
+		if (client == NULL) {
+			// The session is gone, its output goes nowhere
+			private_frame_release(system, frame);
+			return true;
+		}
+		if ((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(SYSTEM_WEB_REPLY_TIMEOUT_MS)) {
+			private_frame_release(system, frame);
+			return false;
+		}
+		vTaskDelay(1);
+	}
+}
+
+static ssize_t private_session_write(void *cookie, const char *buf, size_t len)
+{
+	// Output of the command that my_wsrx is running goes to the requesting session only.
+	// It runs on my_wsrx, which may block, so nothing of it is dropped while the client keeps reading.
+	system_web_t *system = cookie;
+	for (size_t offset = 0; offset < len;) {
+		system_web_frame_t *frame = private_frame_acquire(system, pdMS_TO_TICKS(SYSTEM_WEB_REPLY_TIMEOUT_MS));
+		if (frame == NULL) {
+			ESP_LOGW(__func__, "No free frame for the output of fd %d", system->rx_fd);
+			return offset > 0 ? (ssize_t)offset : -1;
+		}
+		// Never evicted by the drop policy
+		frame->keep = true;
+		size_t n = MIN(len - offset, sizeof(frame->data));
+		memcpy(frame->data, buf + offset, n);
+		frame->len = n;
+		// The frame belongs to the queue from here on
+		if (private_reply_enqueue(system, frame) == false) {
+			ESP_LOGW(__func__, "fd %d did not read its command output for %d ms", system->rx_fd, SYSTEM_WEB_REPLY_TIMEOUT_MS);
+			return offset > 0 ? (ssize_t)offset : -1;
+		}
+		offset += n;
+	}
+	return len;
+}
+
+static void private_task_my_wsrx(system_web_t *system)
 {
 	assert(system != NULL);
-	ESP_LOGI(__func__, "init");
+	// Commands run here print to the session through system_term_out()
+	cookie_io_functions_t io = {.write = private_session_write};
+	FILE *f = fopencookie(system, "w", io);
+	if (f == NULL) {
+		ESP_LOGE(__func__, "fopencookie() failed");
+		vTaskDelete(NULL);
+		return;
+	}
+	setvbuf(f, NULL, _IOFBF, CONFIG_SYSTEM_WEB_BATCH_SIZE);
+#if !CONFIG_IDF_TARGET_LINUX
+	// newlib's stdout and stderr are per task, so esp_console's own help also reaches the session.
+	// On linux they belong to the whole process and stay with it.
+	stdout = f;
+	stderr = f;
+#endif
 	while (1) {
-		if (system->rb_tx == NULL) {
-			vTaskDelay(pdMS_TO_TICKS(1000));
+		size_t item_size;
+		system_web_rx_t *item = xRingbufferReceive(system->rb_rx, &item_size, portMAX_DELAY);
+		if (item == NULL) {
 			continue;
 		}
-		size_t item_size;
-		uint8_t *item = xRingbufferReceive(system->rb_tx, &item_size, pdMS_TO_TICKS(1000));
+		system->rx_fd = item->fd;
+		system_term_run(item->line, f);
+		fflush(f);
+		// A reply that timed out must not fail the next command's output
+		clearerr(f);
+		system->rx_fd = -1;
+		vRingbufferReturnItem(system->rb_rx, (void *)item);
+	}
+	vTaskDelete(NULL);
+}
+
+static void private_batch_flush(system_web_t *system, system_web_frame_t **batch)
+{
+	if (*batch == NULL) {
+		return;
+	}
+	print_all_ws_fds(system, *batch);
+	private_frame_release(system, *batch);
+	*batch = NULL;
+}
+
+static void private_batch_add(system_web_t *system, uint32_t clients, uint32_t enqueued_us, const char *data, size_t len)
+{
+	// Lines for another set of clients start a new frame
+	if (system->batch != NULL && system->batch->clients != clients) {
+		private_batch_flush(system, &system->batch);
+	}
+	while (len > 0) {
+		if (system->batch == NULL) {
+			system->batch = private_frame_acquire(system, 0);
+			if (system->batch == NULL) {
+				// Cannot happen while every client queue respects its length
+				return;
+			}
+			system->batch->clients = clients;
+			system->batch->enqueued_us = enqueued_us;
+		}
+		system_web_frame_t *frame = system->batch;
+		size_t n = MIN(len, sizeof(frame->data) - frame->len);
+		memcpy(frame->data + frame->len, data, n);
+		frame->len += n;
+		data += n;
+		len -= n;
+		if (frame->len == sizeof(frame->data)) {
+			private_batch_flush(system, &system->batch);
+		}
+	}
+}
+
+static uint32_t private_tag_intern(system_web_t *system, const char *tag, const char *key)
+{
+	// tag is a bounded copy, key the logger's pointer, which identifies the tag in the common case.
+	// A freed tag's address can be reused by another tag, so a key match is checked by name.
+	if (tag == NULL) {
+		return 0;
+	}
+	for (int i = 0; key != NULL && i < system->tags_len; i++) {
+		if (system->tag_keys[i] == key && strcmp(system->tags[i], tag) == 0) {
+			return i + 1;
+		}
+	}
+	for (int i = 0; i < system->tags_len; i++) {
+		if (strcmp(system->tags[i], tag) == 0) {
+			if (key != NULL) {
+				system->tag_keys[i] = key;
+			}
+			return i + 1;
+		}
+	}
+	if (system->tags_len == CONFIG_SYSTEM_WEB_TAGS_MAX) {
+		return 0;
+	}
+	strlcpy(system->tags[system->tags_len], tag, sizeof(system->tags[0]));
+	system->tag_keys[system->tags_len] = key;
+	return ++system->tags_len;
+}
+
+// Worst case for level, timestamp, tag id and body length
+#define BIN_RECORD_HEADER_MAX (1 + 5 + 5 + 5)
+
+static void private_bin_record(system_web_frame_t *frame, uint8_t level, bool trace, uint32_t timestamp, uint32_t id, const char *body, size_t body_len)
+{
+	// The caller made sure that BIN_RECORD_HEADER_MAX + body_len bytes are free
+	uint8_t *p = frame->data + frame->len;
+	*p++ = level | (trace ? SYSTEM_WEB_BIN_TRACE : 0);
+	p += private_varint(p, timestamp);
+	p += private_varint(p, id);
+	p += private_varint(p, body_len);
+	memcpy(p, body, body_len);
+	p += body_len;
+	frame->len = p - frame->data;
+	if (id > 0) {
+		frame->tags |= 1ULL << (id - 1);
+	}
+}
+
+static void private_batch_add_bin(system_web_t *system, uint32_t clients, system_log_record_t *log)
+{
+	uint32_t id = private_tag_intern(system, log->tag, log->tag_key);
+	size_t body_len = MIN(log->body_len, CONFIG_SYSTEM_WEB_BATCH_SIZE - 1 - BIN_RECORD_HEADER_MAX);
+	if (log->trace && body_len < log->body_len) {
+		// A cut trace payload cannot be decoded
+		return;
+	}
+	system_web_frame_t *frame = system->batch_bin;
+	if (frame != NULL && (frame->clients != clients || (frame->len + BIN_RECORD_HEADER_MAX + body_len) > sizeof(frame->data))) {
+		private_batch_flush(system, &system->batch_bin);
+		frame = NULL;
+	}
+	if (frame == NULL) {
+		frame = private_frame_acquire(system, 0);
+		if (frame == NULL) {
+			return;
+		}
+		frame->binary = true;
+		frame->clients = clients;
+		frame->enqueued_us = log->enqueued_us;
+		frame->data[frame->len++] = SYSTEM_WEB_BIN_RECORDS;
+		system->batch_bin = frame;
+	}
+	private_bin_record(frame, log->level, log->trace, log->timestamp, id, log->text + log->body, body_len);
+}
+
+static void private_clients_live(system_web_t *system, uint32_t *text, uint32_t *binary)
+{
+	// Clients on the live stream, bit n is clients[n]
+	*text = 0;
+	*binary = 0;
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active == false || client->history_pending) {
+			continue;
+		}
+		if (client->binary) {
+			*binary |= 1u << i;
+		} else {
+			*text |= 1u << i;
+		}
+	}
+	xSemaphoreGive(system->clients_lock);
+}
+
+static bool private_sub_match(system_web_client_t *client, uint8_t level, const char *tag)
+{
+	// Called with subs_lock held, lines that are not ESP_LOGx output always pass
+	if (tag == NULL) {
+		return true;
+	}
+	uint8_t level_max = client->sub_level;
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_SUBS_MAX; i++) {
+		system_web_sub_t *sub = &client->subs[i];
+		if (sub->tag[0] != '\0' && strcmp(sub->tag, tag) == 0) {
+			level_max = sub->level;
+			break;
+		}
+	}
+	return level <= level_max;
+}
+
+static uint32_t private_subscribers(system_web_t *system, uint32_t clients, uint8_t level, const char *tag)
+{
+	uint32_t mask = 0;
+	taskENTER_CRITICAL(&system->subs_lock);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		if ((clients & (1u << i)) && private_sub_match(&system->clients[i], level, tag)) {
+			mask |= 1u << i;
+		}
+	}
+	taskEXIT_CRITICAL(&system->subs_lock);
+	return mask;
+}
+
+static void private_history_write(system_web_t *system, uint64_t pos, const void *data, size_t len)
+{
+	const size_t size = sizeof(system->history);
+	size_t at = pos % size;
+	size_t n = MIN(len, size - at);
+	memcpy(system->history + at, data, n);
+	memcpy(system->history, (const uint8_t *)data + n, len - n);
+}
+
+static void private_history_copy(system_web_t *system, void *out, uint64_t pos, size_t len)
+{
+	const size_t size = sizeof(system->history);
+	size_t at = pos % size;
+	size_t n = MIN(len, size - at);
+	memcpy(out, system->history + at, n);
+	memcpy((uint8_t *)out + n, system->history, len - n);
+}
+
+static void private_history_append(system_web_t *system, system_log_record_t *item)
+{
+	// Every record the sink gets is kept, each client picks its own lines from it at replay
+	const size_t size = sizeof(system->history);
+	system_web_history_t entry = {
+	.level = item->level,
+	.trace = item->trace,
+	.timestamp = item->timestamp,
+	.tag_size = (item->tag != NULL) ? strlen(item->tag) + 1 : 0,
+	.fmt = item->fmt};
+	// Log lines keep their body only, replay puts the prefix back in the client's format
+	const char *text = (item->tag != NULL) ? (item->text + item->body) : item->text;
+	size_t len = (item->tag != NULL) ? item->body_len : item->text_len;
+	// Nothing longer than a frame is ever sent
+	size_t len_max = MIN(size / 4, CONFIG_SYSTEM_WEB_BATCH_SIZE) - sizeof(entry) - entry.tag_size;
+	if (len > len_max) {
+		if (item->trace) {
+			// A cut trace payload cannot be decoded
+			return;
+		}
+		len = len_max;
+	}
+	entry.len = len;
+	size_t need = sizeof(entry) + entry.tag_size + len;
+	while ((system->history_total + need - system->history_first) > size) {
+		system_web_history_t oldest;
+		private_history_copy(system, &oldest, system->history_first, sizeof(oldest));
+		system->history_first += sizeof(oldest) + oldest.tag_size + oldest.len;
+	}
+	private_history_write(system, system->history_total, &entry, sizeof(entry));
+	private_history_write(system, system->history_total + sizeof(entry), item->tag, entry.tag_size);
+	private_history_write(system, system->history_total + sizeof(entry) + entry.tag_size, text, len);
+	system->history_total += need;
+}
+
+static bool private_history_flush(system_web_t *system, system_web_client_t *client, system_web_frame_t *frame)
+{
+	// Called with clients_lock held. Only queued when there is room, history must not trigger the drop policy.
+	uint64_t tags_new = frame->tags & ~client->tags_sent;
+	bool queued = false;
+	if (uxQueueSpacesAvailable(client->queue) >= (tags_new ? 2 : 1)) {
+		if ((tags_new == 0 || private_dict_send(system, client, tags_new)) && uxQueueSpacesAvailable(client->queue) > 0) {
+			queued = private_client_enqueue(system, client, frame);
+		}
+	}
+	private_frame_release(system, frame);
+	return queued;
+}
+
+static bool private_history_encode(system_web_t *system, system_web_frame_t *frame, system_web_history_t *entry, const char *tag, const char *body)
+{
+	// Appends the entry the way the live stream would have sent it, false when it does not fit
+	size_t room = sizeof(frame->data) - frame->len;
+	bool empty = frame->len <= (frame->binary ? 1 : 0);
+	size_t len = entry->len;
+	if (frame->binary) {
+		uint32_t id = private_tag_intern(system, tag, NULL);
+		if ((BIN_RECORD_HEADER_MAX + len) > room) {
+			if (empty == false || entry->trace) {
+				return false;
+			}
+			len = room - BIN_RECORD_HEADER_MAX;
+		}
+		private_bin_record(frame, entry->level, entry->trace, entry->timestamp, id, body, len);
+		return true;
+	}
+	if (tag == NULL) {
+		if (len > room && empty == false) {
+			return false;
+		}
+		len = MIN(len, room);
+		memcpy(frame->data + frame->len, body, len);
+		frame->len += len;
+		return true;
+	}
+	// Same prefix and colors as LOG_FORMAT(), the frontend colors lines by their escape codes
+	static const char letters[] = "NEWIDV";
+	// The color macros can be empty, hence the "" in front of each
+	static const char *colors[] = {"", "" LOG_COLOR_E, "" LOG_COLOR_W, "" LOG_COLOR_I, "" LOG_COLOR_D, "" LOG_COLOR_V};
+	uint8_t level = MIN(entry->level, sizeof(letters) - 2);
+	char prefix[64];
+	int prefix_len = snprintf(prefix, sizeof(prefix), "%s%c (%" PRIu32 ") %s: ", colors[level], letters[level], entry->timestamp, tag);
+	prefix_len = MIN(prefix_len, (int)sizeof(prefix) - 1);
+	const char suffix[] = LOG_RESET_COLOR "\n";
+	size_t fixed = prefix_len + sizeof(suffix) - 1;
+	if ((fixed + len) > room) {
+		if (empty == false || fixed >= room) {
+			return false;
+		}
+		len = room - fixed;
+	}
+	uint8_t *p = frame->data + frame->len;
+	memcpy(p, prefix, prefix_len);
+	p += prefix_len;
+	memcpy(p, body, len);
+	p += len;
+	memcpy(p, suffix, sizeof(suffix) - 1);
+	p += sizeof(suffix) - 1;
+	frame->len = p - frame->data;
+	return true;
+}
+
+static size_t private_history_format(char *out, size_t out_size, system_web_history_t *entry, const char *payload)
+{
+	// The payload starts with the 32 bit format address, entry->fmt is the full pointer
+	if (entry->fmt == NULL || entry->len < sizeof(uint32_t)) {
+		return 0;
+	}
+	size_t len = Myware_log_format(out, out_size, entry->fmt, (const uint8_t *)payload + sizeof(uint32_t), entry->len - sizeof(uint32_t));
+	// The body format ends like LOG_FORMAT(), the prefix and suffix are put back by private_history_encode()
+	const char suffix[] = LOG_RESET_COLOR "\n";
+	if (len >= (sizeof(suffix) - 1) && memcmp(out + len - (sizeof(suffix) - 1), suffix, sizeof(suffix) - 1) == 0) {
+		len -= sizeof(suffix) - 1;
+	} else if (len >= 1 && out[len - 1] == '\n') {
+		len--;
+	}
+	return len;
+}
+
+static bool private_history_wants(system_web_t *system, int slot, uint32_t joined_ms, system_web_history_t *entry, const char *tag)
+{
+	// Lines from before the client connected are replayed up to the history level, later ones like the live stream
+	bool backlog = (int32_t)(entry->timestamp - joined_ms) < 0;
+	if (backlog && entry->level > CONFIG_SYSTEM_WEB_HISTORY_LEVEL) {
+		return false;
+	}
+	return private_subscribers(system, 1u << slot, entry->level, tag) != 0;
+}
+
+static bool private_history_queue(system_web_t *system, int slot, int fd, uint64_t from, uint64_t to, system_web_frame_t *frame, bool done)
+{
+	// Takes clients_lock only to queue the frame, which may be NULL when the entries up to to were all skipped.
+	// Nothing is queued when the slot got another session or the client changed format since the replay looked at it.
+	system_web_client_t *client = &system->clients[slot];
+	bool queued = false;
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	if (client->active && client->fd == fd && client->history_pending && client->history_pos == from && (frame == NULL || frame->binary == client->binary)) {
+		queued = (frame == NULL) || private_history_flush(system, client, frame);
+		frame = NULL;
+		if (queued) {
+			client->history_pos = to;
+			client->history_pending = (done == false);
+		}
+	}
+	xSemaphoreGive(system->clients_lock);
+	if (frame != NULL) {
+		private_frame_release(system, frame);
+	}
+	return queued;
+}
+
+static void private_history_replay(system_web_t *system)
+{
+	// Only called by my_web between batches, so the history holds exactly what the sink has got so far and nothing
+	// writes it meanwhile. Entries are filtered and formatted without clients_lock, which is only held per frame.
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+		bool pending = client->active && client->history_pending;
+		int fd = client->fd;
+		bool binary = client->binary;
+		uint32_t joined_ms = client->joined_ms;
+		if (pending && client->history_pos < system->history_first) {
+			client->history_pos = system->history_first;
+		}
+		// The client's history_pos, it only moves once a frame is queued
+		uint64_t queued_pos = client->history_pos;
+		xSemaphoreGive(system->clients_lock);
+		if (pending == false) {
+			continue;
+		}
+		system_web_frame_t *frame = NULL;
+		uint64_t pos = queued_pos;
+		bool blocked = false;
+		while (pos < system->history_total) {
+			system_web_history_t entry;
+			private_history_copy(system, &entry, pos, sizeof(entry));
+			uint64_t next = pos + sizeof(entry) + entry.tag_size + entry.len;
+			char tag[SYSTEM_LOG_TAG_LEN];
+			private_history_copy(system, tag, pos + sizeof(entry), entry.tag_size);
+			const char *line_tag = (entry.tag_size > 0) ? tag : NULL;
+			if (private_history_wants(system, i, joined_ms, &entry, line_tag) == false) {
+				pos = next;
+				continue;
+			}
+			if (frame == NULL) {
+				frame = (uxQueueSpacesAvailable(client->queue) > 0) ? private_frame_acquire(system, 0) : NULL;
+				if (frame == NULL) {
+					blocked = true;
+					break;
+				}
+				frame->binary = binary;
+				if (frame->binary) {
+					frame->data[frame->len++] = SYSTEM_WEB_BIN_RECORDS;
+				}
+			}
+			char body[CONFIG_SYSTEM_WEB_BATCH_SIZE];
+			private_history_copy(system, body, pos + sizeof(entry) + entry.tag_size, entry.len);
+			char text[CONFIG_SYSTEM_WEB_BATCH_SIZE];
+			system_web_history_t line = entry;
+			if (entry.trace) {
+				// Stored unformatted because only the history wanted it, formatted now that a client does
+				line.trace = false;
+				line.len = private_history_format(text, sizeof(text), &entry, body);
+			}
+			if (private_history_encode(system, frame, &line, line_tag, entry.trace ? text : body) == false) {
+				if (frame->len <= (frame->binary ? 1 : 0)) {
+					// Does not even fit an empty frame, the live stream would not have sent it either
+					pos = next;
+					continue;
+				}
+				// Full, the entry goes into the next frame
+				bool queued = private_history_queue(system, i, fd, queued_pos, pos, frame, false);
+				frame = NULL;
+				if (queued == false) {
+					blocked = true;
+					break;
+				}
+				queued_pos = pos;
+				continue;
+			}
+			pos = next;
+		}
+		if (blocked == false) {
+			// The last frame, or only the skipped entries, and the client joins the live stream
+			private_history_queue(system, i, fd, queued_pos, pos, frame, true);
+		}
+	}
+}
+
+static system_log_want_t private_sink_wants(void *context, uint8_t level, const char *tag)
+{
+	return system_web_wants(context, level, tag);
+}
+
+static void private_task_my_wstx(system_web_t *system)
+{
+	assert(system != NULL);
+	ESP_LOGI(__func__, "init");
+	while (1) {
+		system_log_record_t *item = system_log_receive(system->log, &system->sink, pdMS_TO_TICKS(250));
 		if (item == NULL) {
+			private_history_replay(system);
 			continue;
 		}
-		print_all_ws_fds(system->server, item, item_size);
-		vRingbufferReturnItem(system->rb_tx, (void *)item);
+		uint32_t live_text;
+		uint32_t live_binary;
+		private_clients_live(system, &live_text, &live_binary);
+		// Drain whatever else arrives before the deadline, consecutive lines for the same clients share a frame
+		TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(CONFIG_SYSTEM_WEB_BATCH_FLUSH_MS);
+		while (item != NULL) {
+			private_history_append(system, item);
+			uint32_t text = private_subscribers(system, live_text, item->level, item->tag);
+			uint32_t binary = private_subscribers(system, live_binary, item->level, item->tag);
+			if (text && item->trace == false) {
+				private_batch_add(system, text, item->enqueued_us, item->text, item->text_len);
+			}
+			if (binary) {
+				private_batch_add_bin(system, binary, item);
+			}
+			system_log_release(system->log, &system->sink, item);
+			TickType_t remaining = deadline - xTaskGetTickCount();
+			if ((int32_t)remaining <= 0) {
+				break;
+			}
+			item = system_log_receive(system->log, &system->sink, remaining);
+		}
+		private_batch_flush(system, &system->batch);
+		private_batch_flush(system, &system->batch_bin);
+		private_history_replay(system);
 	}
 	vTaskDelete(NULL);
 }
@@ -89,8 +984,29 @@ esp_err_t system_web_init(system_web_t *system)
 {
 	httpd_handle_t server = NULL;
 	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+	config.server_port = CONFIG_SYSTEM_WEB_PORT;
 	config.max_uri_handlers = 20;
 	config.uri_match_fn = httpd_uri_match_wildcard;
+	config.global_user_ctx = system;
+	config.global_user_ctx_free_fn = private_no_free;
+	config.open_fn = private_on_open;
+	config.close_fn = private_on_close;
+
+	portMUX_INITIALIZE(&system->subs_lock);
+
+#if CONFIG_SYSTEM_WEB_POLICY_DROP_NEWEST
+	system->policy = SYSTEM_WEB_POLICY_DROP_NEWEST;
+#elif CONFIG_SYSTEM_WEB_POLICY_DISCONNECT
+	system->policy = SYSTEM_WEB_POLICY_DISCONNECT;
+#else
+	system->policy = SYSTEM_WEB_POLICY_DROP_OLDEST;
+#endif
+
+	system->clients_lock = xSemaphoreCreateMutex();
+	if (system->clients_lock == NULL) {
+		ESP_LOGE(__func__, "xSemaphoreCreateMutex() failed");
+		return ESP_FAIL;
+	}
 
 	ESP_LOGI(__func__, "Starting HTTP Server on port: '%d'", config.server_port);
 	if (httpd_start(&server, &config) != ESP_OK) {
@@ -99,19 +1015,251 @@ esp_err_t system_web_init(system_web_t *system)
 	}
 	system->server = server;
 
-	system->rb_tx = xRingbufferCreate(1028, RINGBUF_TYPE_NOSPLIT);
-	if (system->rb_tx == NULL) {
-		printf("Failed to create ring buffer\n");
+	system->sink.name = "web";
+	system->sink.level = ESP_LOG_VERBOSE;
+	system->sink.trace = true;
+	system->sink.wants = private_sink_wants;
+	system->sink.context = system;
+	if (system_log_sink_add(system->log, &system->sink) != ESP_OK) {
+		ESP_LOGE(__func__, "system_log_sink_add() failed");
+		return ESP_FAIL;
+	}
+
+	system->rx_fd = -1;
+	system->rb_rx = xRingbufferCreate(CONFIG_SYSTEM_WEB_RB_RX_SIZE, RINGBUF_TYPE_NOSPLIT);
+	if (system->rb_rx == NULL) {
+		ESP_LOGE(__func__, "xRingbufferCreate() failed");
+		return ESP_FAIL;
+	}
+
+	system->frames_free = xQueueCreate(SYSTEM_WEB_FRAME_POOL_SIZE, sizeof(system_web_frame_t *));
+	if (system->frames_free == NULL) {
+		ESP_LOGE(__func__, "xQueueCreate() failed");
+		return ESP_FAIL;
+	}
+	for (int i = 0; i < SYSTEM_WEB_FRAME_POOL_SIZE; i++) {
+		system_web_frame_t *frame = &system->frames[i];
+		xQueueSend(system->frames_free, &frame, 0);
+	}
+
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		client->system = system;
+		client->queue = xQueueCreate(CONFIG_SYSTEM_WEB_CLIENT_QUEUE_LEN, sizeof(system_web_frame_t *));
+		if (client->queue == NULL) {
+			ESP_LOGE(__func__, "xQueueCreate() failed");
+			return ESP_FAIL;
+		}
+		char name[configMAX_TASK_NAME_LEN];
+		snprintf(name, sizeof(name), "my_ws%i", i);
+		xTaskCreate((TaskFunction_t)private_task_my_wsclient, name, 1024 * 3, client, 10, NULL);
 	}
 
 	httpd_uri_t uri_ws = {
 	.uri = "/ws",
 	.method = HTTP_GET,
 	.handler = echo_handler,
-	.user_ctx = NULL,
+	.user_ctx = system,
 	.is_websocket = true};
 	httpd_register_uri_handler(server, &uri_ws);
 
+	// FNV-1a of the gzipped page, so the ETag changes exactly when the embedded bytes do
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (const uint8_t *p = index_html_gz_start; p < index_html_gz_end; p++) {
+		hash = (hash ^ *p) * 0x100000001b3ULL;
+	}
+	snprintf(system->index_etag, sizeof(system->index_etag), "\"%016" PRIx64 "\"", hash);
+	httpd_uri_t uri_index = {
+	.uri = "/",
+	.method = HTTP_GET,
+	.handler = private_index_handler,
+	.user_ctx = system};
+	httpd_register_uri_handler(server, &uri_index);
+	uri_index.uri = "/index.html";
+	httpd_register_uri_handler(server, &uri_index);
+
 	xTaskCreate((TaskFunction_t)private_task_my_wstx, "my_web", 1024 * 10, system, 10, NULL);
+	xTaskCreate((TaskFunction_t)private_task_my_wsrx, "my_wsrx", 1024 * 10, system, 9, NULL);
+	system->started_us = esp_timer_get_time();
+	return ESP_OK;
+}
+
+void system_web_print_clients(system_web_t *system, FILE *f)
+{
+	if (system->clients_lock == NULL) {
+		fprintf(f, "web server is not running\n");
+		return;
+	}
+	fprintf(f, "%-4s %-4s %12s %12s %12s %8s\n", "slot", "fd", "queued", "sent", "dropped", "pending");
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active == false) {
+			continue;
+		}
+		unsigned pending = uxQueueMessagesWaiting(client->queue);
+		fprintf(f, "%-4i %-4i %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %8u\n", i, client->fd, client->bytes_queued, client->bytes_sent, client->bytes_dropped, pending);
+	}
+	xSemaphoreGive(system->clients_lock);
+}
+
+esp_err_t system_web_broadcast(system_web_t *system, const char *data, size_t len)
+{
+	if (system->clients_lock == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	system_web_frame_t *frame = private_frame_acquire(system, 0);
+	if (frame == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	frame->clients = UINT32_MAX;
+	frame->len = MIN(len, sizeof(frame->data));
+	memcpy(frame->data, data, frame->len);
+	print_all_ws_fds(system, frame);
+	private_frame_release(system, frame);
 	return ESP_OK;
 }
+
+void system_web_print_latency(system_web_t *system, FILE *f)
+{
+	if (system->clients_lock == NULL) {
+		fprintf(f, "web server is not running\n");
+		return;
+	}
+	fprintf(f, "%-4s %-4s %10s %10s %10s %10s\n", "slot", "fd", "frames", "p50 us", "p99 us", "max us");
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active == false) {
+			continue;
+		}
+		myware_hist_t *hist = &client->latency;
+		fprintf(f, "%-4i %-4i %10u %10u %10u %10u\n", i, client->fd, (unsigned)Myware_hist_count(hist), (unsigned)Myware_hist_percentile(hist, 500), (unsigned)Myware_hist_percentile(hist, 990), (unsigned)hist->max);
+	}
+	xSemaphoreGive(system->clients_lock);
+}
+
+void system_web_reset_latency(system_web_t *system)
+{
+	if (system->clients_lock == NULL) {
+		return;
+	}
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		Myware_hist_reset(&system->clients[i].latency);
+	}
+	xSemaphoreGive(system->clients_lock);
+}
+
+esp_err_t system_web_set_binary(system_web_t *system, bool binary)
+{
+	esp_err_t e = ESP_ERR_INVALID_STATE;
+	if (system->clients_lock == NULL) {
+		return e;
+	}
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+		system_web_client_t *client = &system->clients[i];
+		if (client->active && client->fd == system->rx_fd) {
+			client->binary = binary;
+			client->tags_sent = 0;
+			e = ESP_OK;
+			break;
+		}
+	}
+	xSemaphoreGive(system->clients_lock);
+	return e;
+}
+
+static system_web_client_t *private_client_session(system_web_t *system)
+{
+	// Client whose command my_wsrx is running, subscriptions are only written by that task
+	system_web_client_t *found = NULL;
+	if (system->clients_lock == NULL) {
+		return NULL;
+	}
+	xSemaphoreTake(system->clients_lock, portMAX_DELAY);
+	found = private_client_session_locked(system);
+	xSemaphoreGive(system->clients_lock);
+	return found;
+}
+
+esp_err_t system_web_subscribe(system_web_t *system, const char *tag, uint8_t level)
+{
+	system_web_client_t *client = private_client_session(system);
+	if (client == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (strcmp(tag, "*") == 0) {
+		taskENTER_CRITICAL(&system->subs_lock);
+		client->sub_level = level;
+		private_subs_update(system);
+		taskEXIT_CRITICAL(&system->subs_lock);
+		return ESP_OK;
+	}
+	if (strlen(tag) >= sizeof(client->subs[0].tag)) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	esp_err_t e = ESP_ERR_NO_MEM;
+	taskENTER_CRITICAL(&system->subs_lock);
+	system_web_sub_t *slot = NULL;
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_SUBS_MAX; i++) {
+		system_web_sub_t *sub = &client->subs[i];
+		if (sub->tag[0] == '\0') {
+			slot = slot ? slot : sub;
+		} else if (strcmp(sub->tag, tag) == 0) {
+			slot = sub;
+			break;
+		}
+	}
+	if (slot != NULL) {
+		strcpy(slot->tag, tag);
+		slot->level = level;
+		e = ESP_OK;
+	}
+	private_subs_update(system);
+	taskEXIT_CRITICAL(&system->subs_lock);
+	return e;
+}
+
+void system_web_print_subs(system_web_t *system, FILE *f)
+{
+	system_web_client_t *client = private_client_session(system);
+	if (client == NULL) {
+		fprintf(f, "not a WebSocket session\n");
+		return;
+	}
+	// Only this task writes the subscriptions, so they can be read without subs_lock
+	fprintf(f, "%-16s %s\n", "*", Myware_log_level_str(client->sub_level));
+	for (int i = 0; i < CONFIG_SYSTEM_WEB_SUBS_MAX; i++) {
+		system_web_sub_t *sub = &client->subs[i];
+		if (sub->tag[0] != '\0') {
+			fprintf(f, "%-16s %s\n", sub->tag, Myware_log_level_str(sub->level));
+		}
+	}
+}
+
+system_log_want_t system_web_wants(system_web_t *system, uint8_t level, const char *tag)
+{
+	// Most lines are decided here without touching subs_lock
+	if (level <= atomic_load(&system->subs_level_max)) {
+		bool want = false;
+		taskENTER_CRITICAL(&system->subs_lock);
+		for (int i = 0; i < CONFIG_SYSTEM_WEB_MAX_CLIENTS; i++) {
+			system_web_client_t *client = &system->clients[i];
+			if (client->active && private_sub_match(client, level, tag)) {
+				want = true;
+				break;
+			}
+		}
+		taskEXIT_CRITICAL(&system->subs_lock);
+		if (want) {
+			return SYSTEM_LOG_WANT_TEXT;
+		}
+	}
+	// Nobody reads it now, the history keeps it unformatted
+	if (level <= CONFIG_SYSTEM_WEB_HISTORY_LEVEL) {
+		return SYSTEM_LOG_WANT_TRACE;
+	}
+	return SYSTEM_LOG_WANT_NONE;
+}
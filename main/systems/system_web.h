@@ -1,11 +1,133 @@
 #pragma once
+#include <sdkconfig.h>
+#include <freertos/FreeRTOS.h>
 #include <freertos/ringbuf.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
 #include <esp_err.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "systems/system_log.h"
+
+// Every client can hold a full queue plus the frame it is sending, history replay stops at a full queue.
+// Command output waits for a free frame when the pool is empty.
+// Being built at the same time: a text batch, a binary batch, a tag dictionary and a command reply.
+#define SYSTEM_WEB_FRAME_POOL_SIZE (CONFIG_SYSTEM_WEB_MAX_CLIENTS * (CONFIG_SYSTEM_WEB_CLIENT_QUEUE_LEN + 1) + 4)
+
+// First byte of a binary frame
+#define SYSTEM_WEB_BIN_DICT    0x01 // repeated: varint tag id, varint length, tag name
+#define SYSTEM_WEB_BIN_RECORDS 0x02 // repeated: u8 level, varint timestamp, varint tag id, varint length, body
+// Set in the level byte when the body is a Myware_log_trace() payload instead of text
+#define SYSTEM_WEB_BIN_TRACE 0x80
+
+// What to do with a batch when a client's send queue is full
+typedef enum {
+	SYSTEM_WEB_POLICY_DROP_OLDEST,
+	SYSTEM_WEB_POLICY_DROP_NEWEST,
+	SYSTEM_WEB_POLICY_DISCONNECT,
+} system_web_policy_t;
+
+// Level filter for one tag, set with web-sub
+typedef struct {
+	char tag[16];
+	uint8_t level;
+} system_web_sub_t;
+
+// Payload built once and shared by every client it is queued to
+typedef struct {
+	atomic_int refs;
+	bool binary;
+	// Command output and tag dictionaries, never evicted from a full queue by the drop policy
+	bool keep;
+	// Interned tags used by the records in a binary frame, or named by a dictionary frame, bit n is tag id n + 1
+	uint64_t tags;
+	// Clients the frame is for, bit n is clients[n]
+	uint32_t clients;
+	// enqueued_us of the first log record in the frame, 0 for history and command output
+	uint32_t enqueued_us;
+	size_t len;
+	uint8_t data[CONFIG_SYSTEM_WEB_BATCH_SIZE];
+} system_web_frame_t;
 
 typedef struct {
+	bool active;
+	int fd;
+	void *system;
+	// Bounded queue of frame pointers, drained by the client's own sender task
+	QueueHandle_t queue;
+	uint64_t bytes_queued;
+	uint64_t bytes_sent;
+	uint64_t bytes_dropped;
+	// Microseconds from the oldest record of a frame being logged to the frame being sent, only written by the client's sender task
+	myware_hist_t latency;
+	// Opted in to binary log frames, tags_sent holds the tags already in its dictionary
+	bool binary;
+	uint64_t tags_sent;
+	// Joined before the history was replayed, history_pos is how far the replay got.
+	// Lines logged before joined_ms are only replayed up to CONFIG_SYSTEM_WEB_HISTORY_LEVEL.
+	bool history_pending;
+	uint64_t history_pos;
+	uint32_t joined_ms;
+	// Highest level sent for tags without an entry in subs, both written under subs_lock
+	uint8_t sub_level;
+	system_web_sub_t subs[CONFIG_SYSTEM_WEB_SUBS_MAX];
+	// Receive buffer reused for every frame of the session, only touched by the httpd task
+	uint8_t rx[CONFIG_SYSTEM_WEB_RX_BUF_SIZE + 1];
+} system_web_client_t;
+
+typedef struct {
+	// Command lines from /ws sessions, executed by my_wsrx
 	RingbufHandle_t rb_rx;
-	RingbufHandle_t rb_tx;
+	// Session fd of the command my_wsrx is running, -1 when idle
+	int rx_fd;
+	// Log records for the WebSocket, read by my_web only
+	system_log_t *log;
+	system_log_sink_t sink;
 	void *server;
+	// WebSocket sessions, maintained by the httpd open/close callbacks and the /ws handshake
+	SemaphoreHandle_t clients_lock;
+	system_web_client_t clients[CONFIG_SYSTEM_WEB_MAX_CLIENTS];
+	system_web_policy_t policy;
+	// Guards the client subscriptions, read by my_vprintf in whatever task is logging
+	portMUX_TYPE subs_lock;
+	// Upper bound of every subscribed level, lets my_vprintf skip the lock for unwanted lines
+	atomic_uint subs_level_max;
+	// Refcounted frames, a frame returns to frames_free when its last client is done with it
+	QueueHandle_t frames_free;
+	system_web_frame_t frames[SYSTEM_WEB_FRAME_POOL_SIZE];
+	system_web_frame_t *batch;
+	system_web_frame_t *batch_bin;
+	// Tag id n + 1 is tags[n], only used by my_web. tag_keys holds the logger's pointer, a fast-path key only.
+	char tags[CONFIG_SYSTEM_WEB_TAGS_MAX][SYSTEM_LOG_TAG_LEN];
+	const char *tag_keys[CONFIG_SYSTEM_WEB_TAGS_MAX];
+	int tags_len;
+	// Latest records the sink got, replayed to new clients through their subscriptions, only used by my_web.
+	// history_first is the oldest whole entry, history_total the end of the newest.
+	uint8_t history[CONFIG_SYSTEM_WEB_HISTORY_SIZE];
+	uint64_t history_first;
+	uint64_t history_total;
+	// Strong ETag of the embedded frontend, quoted
+	char index_etag[20];
+	int64_t started_us;
 } system_web_t;
 
 esp_err_t system_web_init(system_web_t *system);
+void system_web_print_clients(system_web_t *system, FILE *f);
+void system_web_print_latency(system_web_t *system, FILE *f);
+
+// Sends text to every live text client the way my_web sends a log batch, ESP_ERR_NO_MEM when the frame pool is empty
+esp_err_t system_web_broadcast(system_web_t *system, const char *data, size_t len);
+void system_web_reset_latency(system_web_t *system);
+
+// Switches the session whose command is being run by my_wsrx between text and binary log frames
+esp_err_t system_web_set_binary(system_web_t *system, bool binary);
+
+// Sets the highest level the session whose command is being run by my_wsrx receives for tag, "*" for every other tag
+esp_err_t system_web_subscribe(system_web_t *system, const char *tag, uint8_t level);
+void system_web_print_subs(system_web_t *system, FILE *f);
+
+// Checked by the log router before formatting. Text when a client subscribed to the line,
+// trace when only the history keeps it, so that it is formatted only if it is ever replayed.
+system_log_want_t system_web_wants(system_web_t *system, uint8_t level, const char *tag);
@@ -0,0 +1,27 @@
+#!/usr/bin/env python3
+"""Gzips a frontend file for embedding in the firmware.
+
+The output has no timestamp or file name in its header, so the same input
+always gives the same bytes and the ETag the firmware derives from them
+only changes when the page does.
+
+    python tools/gzip_asset.py frontend1/index.html build/index.html.gz
+"""
+
+import gzip
+import sys
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    packed = gzip.compress(data, compresslevel=9, mtime=0)
+    with open(sys.argv[2], "wb") as f:
+        f.write(packed)
+    print(f"{sys.argv[1]}: {len(data)} -> {len(packed)} bytes")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,185 @@
+#!/usr/bin/env python3
+"""WebSocket load test of the log broadcast path.
+
+Opens N clients on /ws and has the firmware log numbered lines with
+log-flood. Every client counts the lines it gets, which measures fan-out
+throughput and loss. Then it times single lines from the log-flood command
+to their arrival at each client, which measures end to end latency without
+comparing device and host clocks.
+
+Runs against a board or the linux target build:
+
+    idf.py --preview set-target linux && idf.py build
+    ./build/file_server.elf &
+    python tools/ws_load.py ws://127.0.0.1:8080/ws --clients 8 --lines 5000
+
+Requires: websockets
+"""
+
+import argparse
+import asyncio
+import os
+import re
+import statistics
+import sys
+import time
+
+import websockets
+
+BIN_RECORDS = 0x02
+LINE = re.compile(rb"flood: (\w+) (\d+)")
+
+
+def varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        if b < 0x80:
+            return value, pos
+        shift += 7
+
+
+def bodies(frame):
+    """Log text in a frame, one item per record for binary frames."""
+    if isinstance(frame, str):
+        return [frame.encode()]
+    if not frame or frame[0] != BIN_RECORDS:
+        return []
+    out = []
+    pos = 1
+    while pos < len(frame):
+        pos += 1  # level
+        _, pos = varint(frame, pos)  # timestamp
+        _, pos = varint(frame, pos)  # tag id
+        length, pos = varint(frame, pos)
+        # Records carry only the body, put the tag back for the regex
+        out.append(b"flood: " + frame[pos : pos + length])
+        pos += length
+    return out
+
+
+class Client:
+    def __init__(self, ws):
+        self.ws = ws
+        # nonce -> {index: arrival time}
+        self.seen = {}
+        self.bytes = 0
+        self.changed = asyncio.Event()
+
+    async def read(self):
+        async for frame in self.ws:
+            now = time.monotonic()
+            self.bytes += len(frame)
+            for body in bodies(frame):
+                for m in LINE.finditer(body):
+                    self.seen.setdefault(m.group(1).decode(), {}).setdefault(int(m.group(2)), now)
+            self.changed.set()
+
+    async def wait(self, nonce, count, timeout):
+        deadline = time.monotonic() + timeout
+        while len(self.seen.get(nonce, ())) < count:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return False
+            self.changed.clear()
+            try:
+                await asyncio.wait_for(self.changed.wait(), remaining)
+            except asyncio.TimeoutError:
+                return False
+        return True
+
+
+def percentile(values, q):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * q))]
+
+
+async def throughput(clients, control, args):
+    nonce = "t" + os.urandom(4).hex()
+    start = time.monotonic()
+    bytes_before = [c.bytes for c in clients]
+    await control.ws.send(f"log-flood -n {args.lines} -s {args.size} {nonce}")
+    await asyncio.gather(*(c.wait(nonce, args.lines, args.timeout) for c in clients))
+    total_lines = 0
+    total_bytes = 0
+    print(f"{'client':>6} {'lines':>8} {'lost':>6} {'seconds':>8} {'lines/s':>9}")
+    for i, c in enumerate(clients):
+        arrivals = c.seen.get(nonce, {})
+        lines = len(arrivals)
+        elapsed = (max(arrivals.values()) - start) if arrivals else 0.0
+        rate = lines / elapsed if elapsed > 0 else 0.0
+        total_lines += lines
+        total_bytes += c.bytes - bytes_before[i]
+        print(f"{i:>6} {lines:>8} {args.lines - lines:>6} {elapsed:>8.3f} {rate:>9.0f}")
+    elapsed = time.monotonic() - start
+    print(f"fan-out: {total_lines} lines, {total_bytes / 1e6:.2f} MB to {len(clients)} clients in {elapsed:.3f} s, "
+          f"{total_lines / elapsed:.0f} lines/s, {total_bytes / 1e6 / elapsed:.2f} MB/s")
+
+
+async def latency(clients, control, args):
+    samples = []
+    lost = 0
+    for k in range(args.pings):
+        nonce = f"p{k}x" + os.urandom(2).hex()
+        start = time.monotonic()
+        await control.ws.send(f"log-flood -n 1 -s {args.size} {nonce}")
+        results = await asyncio.gather(*(c.wait(nonce, 1, args.timeout) for c in clients))
+        for c, ok in zip(clients, results):
+            if ok:
+                samples.append((c.seen[nonce][0] - start) * 1e3)
+            else:
+                lost += 1
+        await asyncio.sleep(args.gap / 1e3)
+    if not samples:
+        print("latency: no line arrived")
+        return
+    print(f"latency over {len(samples)} samples, {lost} lost: "
+          f"p50 {percentile(samples, 0.50):.2f} ms, p99 {percentile(samples, 0.99):.2f} ms, "
+          f"max {max(samples):.2f} ms, mean {statistics.mean(samples):.2f} ms")
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("url", help="ws://host[:port]/ws")
+    parser.add_argument("--clients", type=int, default=4, help="WebSocket clients to open")
+    parser.add_argument("--lines", type=int, default=1000, help="lines logged for the throughput run")
+    parser.add_argument("--size", type=int, default=32, help="padding bytes per line")
+    parser.add_argument("--pings", type=int, default=100, help="single lines timed for the latency run")
+    parser.add_argument("--gap", type=float, default=20, help="ms between latency pings")
+    parser.add_argument("--timeout", type=float, default=10, help="seconds to wait for lines")
+    parser.add_argument("--binary", action="store_true", help="use binary log frames")
+    args = parser.parse_args()
+
+    clients = []
+    for _ in range(args.clients):
+        ws = await websockets.connect(args.url, max_size=None)
+        clients.append(Client(ws))
+    readers = [asyncio.create_task(c.read()) for c in clients]
+    for c in clients:
+        if args.binary:
+            await c.ws.send("web-format binary")
+        # Only the test's lines, whatever else the firmware logs stays out of the numbers
+        await c.ws.send("web-sub * none")
+        await c.ws.send("web-sub flood info")
+    control = clients[0]
+    await control.ws.send("log-rate flood 0")
+    # Let the history replay and the command replies go by
+    await asyncio.sleep(1)
+
+    await throughput(clients, control, args)
+    await latency(clients, control, args)
+
+    for c in clients:
+        await c.ws.close()
+    for r in readers:
+        r.cancel()
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        sys.exit(1)
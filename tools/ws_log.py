@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""Binary log client for the /ws endpoint.
+
+Switches the session to binary log frames and prints them. Trace records
+(log-trace on) carry the address of the format string and the raw arguments,
+they are formatted here using the firmware ELF file.
+
+    python tools/ws_log.py ws://192.168.1.10/ws --elf build/file_server.elf
+
+Requires: websockets, pyelftools (only with --elf)
+"""
+
+import argparse
+import asyncio
+import re
+import struct
+import sys
+
+import websockets
+
+BIN_DICT = 0x01
+BIN_RECORDS = 0x02
+BIN_TRACE = 0x80
+LEVELS = "NEWIDV"
+COLORS = {"E": "\033[0;31m", "W": "\033[0;33m", "I": "\033[0;32m"}
+RESET = "\033[0m"
+
+# Same grammar that Myware_log_trace() walks on the device
+CONVERSION = re.compile(r"%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d*))?(hh|h|ll|l|L|q|j|z|t)?([diouxXcspfFeEgGaA%])")
+
+
+def varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        if b < 0x80:
+            return value, pos
+        shift += 7
+
+
+class Elf:
+    def __init__(self, path):
+        from elftools.elf.elffile import ELFFile
+
+        self.file = open(path, "rb")
+        self.elf = ELFFile(self.file)
+        self.cache = {}
+
+    def string(self, addr):
+        if addr in self.cache:
+            return self.cache[addr]
+        for section in self.elf.iter_sections():
+            start = section["sh_addr"]
+            if section["sh_type"] == "SHT_NOBITS" or not start <= addr < start + section["sh_size"]:
+                continue
+            data = section.data()
+            offset = addr - start
+            end = data.index(b"\0", offset)
+            text = data[offset:end].decode("utf-8", "replace")
+            self.cache[addr] = text
+            return text
+        raise KeyError("no section holds 0x%08x" % addr)
+
+
+def format_trace(elf, payload):
+    (addr,) = struct.unpack_from("<I", payload, 0)
+    pos = 4
+    fmt = elf.string(addr)
+    out = []
+    last = 0
+    for m in CONVERSION.finditer(fmt):
+        out.append(fmt[last : m.start()])
+        last = m.end()
+        flags, width, precision, length, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        if width == "*":
+            (value,) = struct.unpack_from("<i", payload, pos)
+            pos += 4
+            width = str(value)
+        if precision == "*":
+            (value,) = struct.unpack_from("<i", payload, pos)
+            pos += 4
+            precision = str(value)
+        spec = "%" + flags + (width or "") + ("." + precision if precision is not None else "")
+        wide = length in ("ll", "q", "j")
+        if conv in "diouxXc":
+            signed = conv in "di"
+            code = ("<q" if signed else "<Q") if wide else ("<i" if signed else "<I")
+            (value,) = struct.unpack_from(code, payload, pos)
+            pos += 8 if wide else 4
+            out.append((spec + ("d" if conv == "u" else conv)) % value)
+        elif conv == "p":
+            (value,) = struct.unpack_from("<I", payload, pos)
+            pos += 4
+            out.append("0x%x" % value)
+        elif conv == "s":
+            n = payload[pos]
+            value = payload[pos + 1 : pos + 1 + n].decode("utf-8", "replace")
+            pos += 1 + n
+            out.append((spec + "s") % value)
+        else:
+            (value,) = struct.unpack_from("<d", payload, pos)
+            pos += 8
+            out.append(value.hex() if conv in "aA" else (spec + conv) % value)
+    out.append(fmt[last:])
+    return "".join(out)
+
+
+def print_records(frame, tags, elf):
+    pos = 1
+    while pos < len(frame):
+        level = frame[pos]
+        pos += 1
+        timestamp, pos = varint(frame, pos)
+        tag_id, pos = varint(frame, pos)
+        length, pos = varint(frame, pos)
+        body = frame[pos : pos + length]
+        pos += length
+        letter = LEVELS[level & 0x7F] if (level & 0x7F) < len(LEVELS) else "?"
+        if level & BIN_TRACE:
+            if elf is None:
+                text = "<trace record, run with --elf>"
+            else:
+                try:
+                    text = format_trace(elf, body)
+                except (KeyError, ValueError, struct.error, IndexError) as e:
+                    text = "<undecodable trace record: %s>" % e
+        else:
+            text = body.decode("utf-8", "replace")
+        tag = tags.get(tag_id, "?")
+        print("%s%s (%d) %s: %s%s" % (COLORS.get(letter, ""), letter, timestamp, tag, text.rstrip("\n"), RESET))
+
+
+async def run(url, elf, commands):
+    tags = {}
+    async with websockets.connect(url) as ws:
+        await ws.send("web-format binary")
+        for command in commands:
+            await ws.send(command)
+        async for frame in ws:
+            if isinstance(frame, str):
+                sys.stdout.write(frame)
+                continue
+            if frame[0] == BIN_DICT:
+                pos = 1
+                while pos < len(frame):
+                    tag_id, pos = varint(frame, pos)
+                    length, pos = varint(frame, pos)
+                    tags[tag_id] = frame[pos : pos + length].decode("utf-8", "replace")
+                    pos += length
+            elif frame[0] == BIN_RECORDS:
+                print_records(frame, tags, elf)
+            sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("url", help="WebSocket url, for example ws://192.168.1.10/ws")
+    parser.add_argument("--elf", help="firmware ELF used to format trace records")
+    parser.add_argument("--command", "-c", action="append", default=[], help="console command to send after connecting")
+    args = parser.parse_args()
+    elf = Elf(args.elf) if args.elf else None
+    try:
+        asyncio.run(run(args.url, elf, args.command))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()